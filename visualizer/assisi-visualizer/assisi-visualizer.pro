@@ -11,10 +11,39 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 TARGET = assisi-visualizer
 TEMPLATE = app
 
+CONFIG += c++11
+
+# Count heap allocations, reported by the decode benchmark:
+# qmake CONFIG+=count_allocations
+count_allocations {
+    DEFINES += ASSISI_COUNT_ALLOCATIONS
+}
+
 
 SOURCES += \
     src/main.cpp \
     src/subscriber.cpp \
+    src/entitystore.cpp \
+    src/ingestor.cpp \
+    src/nametable.cpp \
+    src/bytespan.cpp \
+    src/positionbatch.cpp \
+    src/spatialgrid.cpp \
+    src/wirescanner.cpp \
+    src/animator.cpp \
+    src/densitymap.cpp \
+    src/scene.cpp \
+    src/scenerenderer.cpp \
+    src/benchmark.cpp \
+    src/renderbenchmark.cpp \
+    src/decodebenchmark.cpp \
+    src/historybenchmark.cpp \
+    src/spatialbenchmark.cpp \
+    src/allocationcounter.cpp \
+    src/framerenderer.cpp \
+    src/framescheduler.cpp \
+    src/spriteatlas.cpp \
+    src/spritebatch.cpp \
     src/visualizer.cpp \
     src/msg/base_msgs.pb.cc \
     src/msg/dev_msgs.pb.cc \
@@ -22,6 +51,29 @@ SOURCES += \
 
 HEADERS  += \
     include/subscriber.h \
+    include/entitystore.h \
+    include/ingestor.h \
+    include/nametable.h \
+    include/bytespan.h \
+    include/positionbatch.h \
+    include/spatialgrid.h \
+    include/wirescanner.h \
+    include/spscqueue.h \
+    include/ringbuffer.h \
+    include/animator.h \
+    include/densitymap.h \
+    include/scene.h \
+    include/scenerenderer.h \
+    include/benchmark.h \
+    include/renderbenchmark.h \
+    include/decodebenchmark.h \
+    include/historybenchmark.h \
+    include/spatialbenchmark.h \
+    include/allocationcounter.h \
+    include/framerenderer.h \
+    include/framescheduler.h \
+    include/spriteatlas.h \
+    include/spritebatch.h \
     include/visualizer.h \
     include/nzmqt/nzmqt.hpp \
     include/msg/base_msgs.pb.h \
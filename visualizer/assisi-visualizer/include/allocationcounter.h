@@ -0,0 +1,23 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+//! Counts heap allocations of the whole process
+/*!
+ * Only active when built with CONFIG+=count_allocations, which defines
+ * ASSISI_COUNT_ALLOCATIONS. On glibc malloc() is interposed, so allocations
+ * made by Qt, protobuf and ZMQ are counted as well. Elsewhere only the
+ * global operator new is replaced.
+ */
+class AllocationCounter
+{
+public:
+    //! Returns true if allocations are counted in this build
+    static bool enabled();
+
+    //! Number of allocations since the start of the process
+    static quint64 count();
+};
+
+#endif // ALLOCATIONCOUNTER_H
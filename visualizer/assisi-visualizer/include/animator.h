@@ -0,0 +1,99 @@
+#ifndef ANIMATOR_H
+#define ANIMATOR_H
+
+#include <QElapsedTimer>
+#include <QPointF>
+#include <QVector>
+
+//! Animated properties of a scene item
+struct Keyframe
+{
+    Keyframe(const QPointF& kpos = QPointF(), double krotation = 0.0, double kopacity = 1.0);
+
+    QPointF pos;
+    //! Degrees, clockwise
+    double rotation;
+    //! 0.0 is transparent, 1.0 is opaque
+    double opacity;
+};
+
+//! Time based animations
+/*!
+ * A tween interpolates between two keyframes over a fixed duration of
+ * the monotonic animation clock. Tweens are sampled at frame time, so the
+ * frame rate changes how smooth an animation looks, but not how fast
+ * it runs.
+ *
+ * Tweens are kept in a pool and referenced by id. Released ids are
+ * reused, so starting animations does not allocate once the pool has
+ * grown to the number of simultaneous tweens.
+ */
+class Animator
+{
+public:
+    //! Progress curves, named like QEasingCurve::Type
+    /*!
+     * A plain enum, so that tweens can be copied without allocating,
+     * which QEasingCurve does.
+     */
+    enum Easing
+    {
+        Linear,
+        InQuad,
+        OutQuad,
+        InOutQuad,
+        InOutSine
+    };
+
+    Animator();
+
+    //! Current time of the animation clock, in nanoseconds
+    qint64 now() const;
+
+    //! Start interpolating from -> to, returns the tween id
+    /*!
+     * duration and delay are in seconds. Until the delay has passed
+     * the tween stays at from.
+     */
+    int start(const Keyframe& from, const Keyframe& to,
+              double duration, double delay = 0.0,
+              Easing easing = Linear);
+
+    //! Return the tween to the pool
+    void release(int id);
+
+    //! Returns the tween value at time
+    /*!
+     * Before the start the value is from, after the end it is to.
+     */
+    Keyframe sample(int id, qint64 time) const;
+
+    //! Returns true if the tween has reached its end value at time
+    bool finished(int id, qint64 time) const;
+
+    //! Number of tweens in use
+    int size() const;
+
+private:
+    //! Eased progress for progress in [0,1]
+    static double ease(Easing easing, double progress);
+
+    struct Tween
+    {
+        Keyframe from;
+        Keyframe to;
+        // Nanoseconds on clock_
+        qint64 start;
+        qint64 duration;
+        Easing easing;
+        bool used;
+    };
+
+    QElapsedTimer clock_;
+
+    QVector<Tween> tweens_;
+    //! Ids of released tweens
+    QVector<int> free_;
+};
+
+#endif // ANIMATOR_H
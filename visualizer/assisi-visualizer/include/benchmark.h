@@ -0,0 +1,61 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QElapsedTimer>
+#include <QtGlobal>
+
+#include <vector>
+
+//! Workload run from the command line, see main()
+/*!
+ * A benchmark only describes its workload in run(). Timing, statistics
+ * and keeping results alive are shared, so all benchmarks measure and
+ * report the same way.
+ */
+class Benchmark
+{
+public:
+    virtual ~Benchmark();
+
+    //! Run the workload and print the statistics
+    /*!
+     * Returns 0 on success, to be used as exit code.
+     */
+    virtual int run() = 0;
+
+    //! Durations of repeated runs of the same work
+    class Samples
+    {
+    public:
+        Samples();
+
+        void reserve(int count);
+
+        //! Start timing a run
+        void start();
+        //! Time since start(), in ns
+        qint64 elapsed() const;
+        //! Add the time since start() as a sample, and return it
+        qint64 stop();
+        //! Add a duration, in ns
+        void add(qint64 duration);
+
+        int size() const;
+        //! Mean duration in ns, 0 without samples
+        double mean() const;
+        //! Nearest rank percentile in ns, 0 < p <= 1, 0 without samples
+        qint64 percentile(double p) const;
+        qint64 max() const;
+
+    private:
+        QElapsedTimer timer_;
+        //! Sorted on demand by percentile()
+        mutable std::vector<qint64> durations_;
+        mutable bool sorted_;
+    };
+
+    //! Keep the compiler from dropping the computation of value
+    static void keep(double value);
+};
+
+#endif // BENCHMARK_H
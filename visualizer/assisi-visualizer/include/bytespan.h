@@ -0,0 +1,67 @@
+#ifndef BYTESPAN_H
+#define BYTESPAN_H
+
+#include <cstddef>
+
+//! Read only view of bytes, e.g. a message frame, which is not terminated
+/*!
+ * Text frames are tokenized and their numbers parsed in place, without
+ * copying them into strings.
+ */
+class ByteSpan
+{
+public:
+    ByteSpan();
+    ByteSpan(const char* data, std::size_t size);
+
+    const char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool isEmpty() const { return size_ == 0; }
+
+    //! Returns the span without leading and trailing white space
+    ByteSpan trimmed() const;
+
+    //! Returns true if the span holds exactly the C string str
+    bool equals(const char* str) const;
+
+    //! Parse the whole span, surrounding white space is ignored
+    /*!
+     * Returns false, leaving value unchanged, if the span is not a number.
+     * Plain decimal numbers are parsed directly, and exactly rounded where
+     * that is possible without big number arithmetic; anything else is
+     * passed on to QByteArray::toDouble(). '.' is the decimal point,
+     * whatever the locale. Neither path allocates once warmed up.
+     */
+    bool toDouble(double* value) const;
+
+    //! Parse the whole span as a decimal integer, see toDouble()
+    bool toInt(int* value) const;
+
+private:
+    const char* data_;
+    std::size_t size_;
+};
+
+//! Splits a span at a separator, in place
+/*!
+ * "a,b," yields "a", "b" and "". An empty span yields a single empty token.
+ */
+class SpanTokenizer
+{
+public:
+    SpanTokenizer(const ByteSpan& span, char separator);
+
+    //! Returns false once all tokens have been returned
+    bool next(ByteSpan* token);
+
+    //! Returns true if all tokens have been returned
+    bool atEnd() const;
+
+private:
+    const char* pos_;
+    const char* end_;
+    char separator_;
+    bool done_;
+};
+
+#endif // BYTESPAN_H
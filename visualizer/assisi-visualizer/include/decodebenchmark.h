@@ -0,0 +1,30 @@
+#ifndef DECODEBENCHMARK_H
+#define DECODEBENCHMARK_H
+
+#include "benchmark.h"
+
+//! Feeds synthetic messages through the ingestion path and reports costs
+/*!
+ * Every message type the visualizer receives is decoded repeatedly by the
+ * Ingestor, without sockets, and the time and number of heap allocations
+ * per message are printed. Allocations are only counted in builds with
+ * CONFIG+=count_allocations.
+ */
+class DecodeBenchmark : public Benchmark
+{
+public:
+    explicit DecodeBenchmark(int messages);
+
+    //! Decode all message types and print the statistics
+    /*!
+     * Fails if a message allocates once warmed up, or does not produce
+     * all its deltas.
+     */
+    int run();
+
+private:
+    //! Messages decoded per message type
+    int messages_;
+};
+
+#endif // DECODEBENCHMARK_H
@@ -0,0 +1,74 @@
+#ifndef DENSITYMAP_H
+#define DENSITYMAP_H
+
+#include <QImage>
+#include <QPointF>
+#include <QRectF>
+
+#include <vector>
+
+//! Decaying occupancy grid of tracked agents
+/*!
+ * Every position update adds weight to the grid cells around it, and the
+ * whole grid decays exponentially with time, so the map shows where the
+ * agents have spent the last few half-lives. Splatting is constant time,
+ * the per frame decay and colour mapping only depend on the grid size,
+ * not on the number of agents or updates.
+ *
+ * The colour mapped grid is an image with one pixel per cell, meant to
+ * be scaled smoothly onto area().
+ */
+class DensityMap
+{
+public:
+    //! Grid of square cells covering area, both in scene coordinates
+    DensityMap(const QRectF& area, double cell_size);
+
+    //! Time after which a splat has lost half of its weight, in seconds
+    void setHalfLife(double seconds);
+    //! Weight shown with the hottest colour
+    void setSaturation(double weight);
+
+    //! Add weight at pos, given in scene coordinates
+    void splat(const QPointF& pos, double weight = 1.0);
+
+    //! Decay the grid to time and colour map it
+    /*!
+     * time is in nanoseconds on any monotonic clock.
+     * Returns true if image() has changed.
+     */
+    bool update(qint64 time);
+
+    //! Returns true while any cell is visible
+    bool active() const;
+
+    const QRectF& area() const;
+    //! Colour mapped grid, one pixel per cell
+    const QImage& image() const;
+
+private:
+    //! Multiply all cells by factor, and update max_
+    void decay(float factor);
+    void colorize();
+
+    QRectF area_;
+    double cell_size_;
+    int cols_;
+    int rows_;
+
+    std::vector<float> cells_;
+    //! Largest cell value
+    float max_;
+    //! Cells have changed since the last update()
+    bool changed_;
+    qint64 last_update_;
+
+    double half_life_;
+    double saturation_;
+
+    //! Premultiplied colours from empty to saturated
+    QRgb lut_[256];
+    QImage image_;
+};
+
+#endif // DENSITYMAP_H
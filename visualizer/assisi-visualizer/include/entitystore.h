@@ -0,0 +1,226 @@
+#ifndef ENTITYSTORE_H
+#define ENTITYSTORE_H
+
+#include "ringbuffer.h"
+#include "spatialgrid.h"
+
+#include <QHash>
+#include <QPointF>
+#include <QRectF>
+#include <QSizeF>
+
+#include <vector>
+
+class DensityMap;
+
+//! Tracked agents of one kind, fish or ribots
+/*!
+ * An agent gets a dense slot the first time its tracker id is seen. All
+ * agent data lives in per-field arrays indexed by slot, so iterating over
+ * the agents walks memory linearly, and thousands of agents cost no more
+ * than one lookup per position update.
+ *
+ * Positions are staged in tracker coordinates while messages are applied,
+ * and committed together: the tank transform is applied to the whole batch
+ * in one pass over contiguous arrays, then the agents are moved.
+ *
+ * The swimming direction of every agent is estimated from its angular
+ * velocity around the centre of the tank, updated with each position, and
+ * the number of agents swimming either way is kept up to date as agents
+ * change direction, so the group direction is known without a rescan.
+ *
+ * With prediction enabled, every agent carries an alpha-beta filter of its
+ * position and velocity, updated with each position. predict() moves the
+ * agents along their velocity at frame time, between positions and for a
+ * short while after the last one, so motion stays smooth when the tracker
+ * publishes slower than the display refreshes.
+ *
+ * Neighbour queries go through a uniform grid over the displayed
+ * positions, rebuilt on the first query after agents have moved.
+ */
+class EntityStore
+{
+public:
+    //! Positions kept per agent, including the current one
+    static const int history_size = 10;
+    typedef RingBuffer<QPointF,history_size> History;
+
+    //! sprite_size is the size of the rendered agent, in scene coordinates
+    explicit EntityStore(const QSizeF& sprite_size = QSizeF(100, 30));
+
+    //! Map tracker coordinates to the scene: scene = tracker*scale + offset
+    void setTransform(double scale_x, double scale_y, double offset_x, double offset_y);
+
+    //! Occupancy map every committed position is added to, may be NULL
+    void setDensityMap(DensityMap* density);
+
+    //! Point the agents swim around, in scene coordinates
+    void setCenter(const QPointF& center);
+
+    //! Extrapolate positions at most max_age ns after the last one, 0 disables prediction
+    void setPrediction(qint64 max_age);
+    qint64 prediction() const;
+
+    //! Remove all agents
+    void clear();
+
+    //! Returns the slot of the agent with a tracker id, adding it if needed
+    int slot(int id);
+
+    //! Returns the slot of the agent, -1 if it has not been seen
+    int find(int id) const;
+
+    //! Number of agents, their slots are 0 to size() - 1
+    int size() const;
+
+    //! Tracker id of the agent in slot
+    int id(int slot) const;
+
+    //! Queue a position, in tracker coordinates, for the next commit()
+    /*!
+     * heading is in radians, counterclockwise, NaN if unknown. time is
+     * the tracker time of the position in seconds, NaN if unknown, in
+     * which case the commit time is used.
+     */
+    void stage(int slot, double x, double y, double heading, double time);
+
+    //! Move the agents to the staged positions
+    /*!
+     * time is the current time, in ns of the animator clock.
+     */
+    void commit(qint64 time);
+
+    //! Move the agents to where they are expected at time, in ns of the animator clock
+    /*!
+     * Returns true while any agent is still being extrapolated, i.e. the
+     * agents keep moving without new positions.
+     */
+    bool predict(qint64 time);
+
+    //! Displayed position, in scene coordinates
+    QPointF position(int slot) const;
+
+    //! Last position received, in scene coordinates
+    QPointF sample(int slot) const;
+
+    //! Estimated velocity, in scene coordinates per second
+    QPointF velocity(int slot) const;
+
+    //! Heading reported by the tracker, NaN if unknown
+    double heading(int slot) const;
+
+    //! Swimming direction, +1 is CCW, -1 is CW, 0 until it is known
+    int direction(int slot) const;
+
+    //! Smoothed angular velocity around the centre, in rad/s, CCW
+    double angularVelocity(int slot) const;
+
+    //! Direction most agents swim in, 0 if no direction is known or tied
+    int groupDirection() const;
+
+    //! Agents swimming CCW minus those swimming CW, over those with a direction
+    /*!
+     * 1 if all swim CCW, -1 if all swim CW, 0 without agents of known
+     * direction.
+     */
+    double polarization() const;
+
+    //! Positions received for the agent, in scene coordinates
+    const History& history(int slot) const;
+
+    //! Rectangle for rendering the agent
+    QRectF pose(int slot) const;
+
+    //! Index of the displayed positions, the points are slots
+    const SpatialGrid& grid() const;
+
+    //! Returns the agent closest to pos, at most max_distance away, or -1
+    int pick(const QPointF& pos, double max_distance) const;
+
+    //! Mean distance from every agent to its nearest neighbour, NaN with less than two agents
+    double meanNeighbourDistance() const;
+
+    //! Length of the mean heading of the moving agents
+    /*!
+     * 1 if all agents swim the same way, close to 0 if their headings
+     * are random, 0 if no agent moves.
+     */
+    double alignment() const;
+
+    //! Agents moved since the last clearDirty()
+    const std::vector<int>& dirtySlots() const;
+
+    //! Pose of the agent at the last clearDirty(), null if it was not shown
+    QRectF paintedPose(int slot) const;
+
+    //! Mark the current poses as painted
+    void clearDirty();
+
+private:
+    QRectF poseAt(double x, double y) const;
+
+    //! Move an agent to a new direction, keeping the counts
+    void setDirection(int slot, int direction);
+
+    //! Move the displayed agent, and mark it for repainting
+    void moveTo(int slot, double x, double y);
+
+    QSizeF sprite_size_;
+    double scale_x_;
+    double scale_y_;
+    double offset_x_;
+    double offset_y_;
+    DensityMap* density_;
+    double center_x_;
+    double center_y_;
+    qint64 max_prediction_age_;
+
+    QHash<int,int> slots_;
+
+    // Agent fields, indexed by slot
+    std::vector<int> ids_;
+    // Displayed position
+    std::vector<double> x_;
+    std::vector<double> y_;
+    // Last received position, and its tracker time
+    std::vector<double> sample_x_;
+    std::vector<double> sample_y_;
+    std::vector<double> sample_time_;
+    // Motion model: filtered position at update_time_, and velocity
+    std::vector<double> filter_x_;
+    std::vector<double> filter_y_;
+    std::vector<double> velocity_x_;
+    std::vector<double> velocity_y_;
+    std::vector<qint64> update_time_;
+    std::vector<double> heading_;
+    std::vector<double> angular_velocity_;
+    std::vector<signed char> direction_;
+    std::vector<double> painted_x_;
+    std::vector<double> painted_y_;
+    std::vector<char> dirty_;
+
+    std::vector<History> history_;
+
+    std::vector<int> dirty_slots_;
+
+    //! Rebuilt lazily by grid()
+    mutable SpatialGrid grid_;
+    mutable bool grid_stale_;
+
+    // Agents by direction
+    int ccw_count_;
+    int cw_count_;
+
+    // Positions waiting for commit()
+    std::vector<int> staged_slots_;
+    std::vector<double> staged_x_;
+    std::vector<double> staged_y_;
+    std::vector<double> staged_heading_;
+    std::vector<double> staged_time_;
+    //! Angular velocity around the centre since the previous position, rad/s
+    std::vector<double> staged_angular_;
+    //! Seconds since the previous position
+    std::vector<double> staged_interval_;
+};
+
+#endif // ENTITYSTORE_H
@@ -0,0 +1,55 @@
+#ifndef FRAMERENDERER_H
+#define FRAMERENDERER_H
+
+#include "scene.h"
+
+#include <QImage>
+#include <QObject>
+#include <QRegion>
+
+class SceneRenderer;
+
+//! Renders frames on a dedicated thread
+/*!
+ * Lives in the render thread and paints scene states into a pair of
+ * offscreen images. The finished image is handed to the GUI thread,
+ * which only blits it, while the next frame is painted into the other one.
+ */
+class FrameRenderer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FrameRenderer(const SceneLayout& layout, QObject *parent = 0);
+    ~FrameRenderer();
+
+public slots:
+    //! Paint the damaged region of the scene into the back buffer
+    /*!
+     * size is the widget size in device independent pixels.
+     * Emits frameReady() once done.
+     */
+    void render(const SceneState& state, const QRegion& damage, const QSize& size, qreal dpr);
+
+signals:
+    //! A new frame is available
+    /*!
+     * Only the damaged region differs from the previous frame.
+     * render_time is the time spent painting, in nanoseconds.
+     */
+    void frameReady(const QImage& frame, const QRegion& damage, qint64 render_time);
+
+private:
+    SceneLayout layout_;
+
+    //! Created in the render thread on first use
+    SceneRenderer* scene_;
+
+    // Double buffering
+    QImage buffers_[2];
+    int back_;
+    //! Damage of the last frame, missing from the back buffer
+    QRegion previous_damage_;
+};
+
+#endif // FRAMERENDERER_H
@@ -0,0 +1,84 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+//! Decides when the next frame is produced
+/*!
+ * Frames are only produced when something asked for one (new data
+ * arrived) or while an animation is running, and never faster than the
+ * configured rate. While a frame is being rendered no new one is
+ * started, and frame slots that are missed because rendering overran
+ * its budget are skipped (dropped) instead of being caught up.
+ */
+class FrameScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FrameScheduler(QObject *parent = 0);
+
+    //! Set the maximal frame rate
+    /*!
+     * Rates that are not positive are ignored, rates above 1000 are
+     * clamped to 1000.
+     */
+    void setMaxFps(double fps);
+    double maxFps() const;
+
+    //! Frames per second achieved during the last second
+    double fps() const;
+    //! Total number of skipped frame slots
+    qint64 droppedFrames() const;
+
+public slots:
+    //! Ask for a frame, e.g. after the displayed data has changed
+    void requestFrame();
+
+    //! Keep producing frames at the maximal rate while animating
+    void setAnimating(bool animating);
+
+    //! The frame handed out by frame() is being rendered
+    void frameStarted();
+
+    //! The frame is done, rendering took render_time nanoseconds
+    void frameFinished(qint64 render_time);
+
+signals:
+    //! Produce a frame, dt is the time since the previous one in seconds
+    void frame(double dt);
+
+    //! Emitted once per second while frames are produced
+    void statistics(double fps, qint64 dropped_frames);
+
+private slots:
+    void tick();
+
+private:
+    //! Arm the timer for the next frame slot, if a frame is wanted
+    void schedule();
+
+    QTimer timer_;
+    QElapsedTimer clock_;
+
+    // All times in nanoseconds on clock_
+    qint64 interval_;
+    qint64 next_frame_;
+    qint64 last_frame_;
+
+    bool pending_;
+    bool animating_;
+    bool busy_;
+    //! Frames have been produced back to back since the last one
+    bool continuous_;
+
+    // Statistics
+    qint64 dropped_;
+    qint64 window_start_;
+    int window_frames_;
+    double fps_;
+};
+
+#endif // FRAMESCHEDULER_H
@@ -0,0 +1,26 @@
+#ifndef HISTORYBENCHMARK_H
+#define HISTORYBENCHMARK_H
+
+#include "benchmark.h"
+
+//! Compares the ways of keeping the last positions of every agent
+/*!
+ * Positions of a number of agents are appended to their histories, and the
+ * histories are read back, once with a pair of QLists per agent, filled with
+ * push_front() and trimmed with pop_back(), and once with the RingBuffer
+ * used by EntityStore. The time per append and per read is printed.
+ */
+class HistoryBenchmark : public Benchmark
+{
+public:
+    explicit HistoryBenchmark(int agents);
+
+    //! Run both variants and print the statistics, fails if they disagree
+    int run();
+
+private:
+    //! Number of histories
+    int agents_;
+};
+
+#endif // HISTORYBENCHMARK_H
@@ -0,0 +1,285 @@
+#ifndef INGESTOR_H
+#define INGESTOR_H
+
+#include "nametable.h"
+#include "spscqueue.h"
+#include "wirescanner.h"
+#include "dev_msgs.pb.h"
+
+#include <QObject>
+#include <nzmqt/nzmqt.hpp>
+
+#include <QByteArray>
+#include <QHash>
+#include <QTimer>
+#include <QVector>
+
+#include <atomic>
+
+//! Compact change of the displayed state
+/*!
+ * Plain data, so it can be passed between threads without allocating.
+ */
+struct StateDelta
+{
+    enum Type
+    {
+        //! value[0] is the wax temperature
+        CasuTemp,
+        //! value[0] is the peltier setpoint
+        CasuSetpoint,
+        //! value[0..count-1] are raw IR readings
+        CasuIr,
+        //! count is the number shown in the message sent to CATS
+        CasuMessage,
+        //! value[0], value[1] are the fish and ribot directions, +1 is CCW
+        CatsMessage,
+        //! value[0], value[1] are x, y in tracker coordinates, value[2] is
+        //! the heading in radians and value[3] the tracker time in seconds,
+        //! both NaN if not sent
+        FishPosition,
+        RibotPosition
+    };
+
+    Type type;
+    //! Index of the CASU, or fish or ribot id
+    int id;
+    int count;
+    double value[6];
+};
+
+//! Receives and parses messages in its own thread
+/*!
+ * The Ingestor is moved to an ingestion thread, where it owns the ZMQ
+ * context and socket. Received messages are parsed there, in the buffers
+ * ZMQ received them into, and turned into StateDeltas pushed to a bounded
+ * queue, so neither painting nor a message burst can delay the other side.
+ * The consumer drains the queue on the GUI thread.
+ *
+ * deltasAvailable() is emitted once after a batch of messages queued
+ * deltas, and again only after the consumer called rearm().
+ *
+ * Sensor readings and positions are state snapshots, only the newest one
+ * matters to the display. Messages of conflated topics and devices are not
+ * parsed on arrival: the latest message per CASU and device, or per tracked
+ * agent, is kept in a slot, replacing the one before it. The slots are
+ * parsed when a batch of received messages ends, so a burst of readings
+ * costs the parse work of one reading per key, without delaying the last
+ * one. A timer flushes messages that were not handed over in a batch.
+ * Event-like messages (CATS messages, CommEth) are always parsed
+ * immediately.
+ *
+ * A position batch turns into one delta per agent, and is only queued
+ * once there is room for all of them, so a batch is never cut. Until then
+ * it waits in a slot like a conflated message, and is replaced if a newer
+ * batch arrives, so a consumer that falls behind makes the ingestor skip
+ * tracker ticks instead of dropping positions.
+ */
+class Ingestor : public QObject, public nzmqt::ZMQMessageHandler
+{
+    Q_OBJECT
+
+public:
+    //! casu_names are the CASUs deltas can refer to, by index
+    Ingestor(const QList<QString>& addresses,
+             const QList<QString>& topics,
+             const QList<QString>& casu_names,
+             QObject *parent = 0);
+    ~Ingestor();
+
+    //! Largest position batch accepted, in records
+    /*!
+     * The queue holds two batches of this size.
+     */
+    static const int max_batch_records = 8192;
+
+    //! Queue of parsed deltas, only popped by the consumer thread
+    SpscQueue<StateDelta>& queue();
+
+    //! Consumer: allow the next deltasAvailable(), call before draining
+    void rearm();
+
+    //! Number of deltas lost because the queue was full, position batches wait instead
+    quint64 droppedDeltas() const;
+
+    //! Conflate the messages of a topic, call before start()
+    /*!
+     * CASU and position topics are conflated by default. Messages from a
+     * CASU are conflated only if their device is conflated too.
+     */
+    void setTopicConflated(const QString& topic, bool conflated);
+
+    //! Conflate the messages of a CASU device, e.g. "IR", call before start()
+    /*!
+     * Temp, Peltier and IR are conflated by default.
+     */
+    void setDeviceConflated(const QString& device, bool conflated);
+
+    //! Set the time after which conflated messages are flushed outside a batch, 33 ms by default
+    void setFlushInterval(int msec);
+
+    //! Number of messages received
+    quint64 receivedMessages() const;
+
+    //! Number of messages replaced by a newer one before being parsed
+    quint64 coalescedMessages() const;
+
+    //! Number of messages ignored because they could not be parsed
+    quint64 malformedMessages() const;
+
+    //! Number of position batches missing from the sequence
+    quint64 lostBatches() const;
+
+    //! Parse a message and queue the resulting deltas
+    /*!
+     * Called by the socket, in the ingestion thread. Text frames are
+     * tokenized and parsed in place, and the displayed values of sensor
+     * payloads are scanned from the frame. Payloads the scanner cannot read
+     * are parsed into message objects that are reused, so that messages do
+     * not allocate once warmed up. Malformed messages are counted and
+     * ignored.
+     */
+    void handleMessage(nzmqt::ZMQSocket* socket, const nzmqt::ZMQMultipartMessage& message);
+
+    //! Parse the conflated messages of a batch, and signal the queued deltas
+    void handleBatchEnd(nzmqt::ZMQSocket* socket, int messages);
+
+public slots:
+    //! Create the context and connect, runs in the ingestion thread
+    void start();
+
+    //! Keep checking for messages for usec microseconds after draining a socket
+    /*!
+     * Lowers latency at the cost of a busy ingestion thread, 0 disables spinning.
+     */
+    void setSpinBudget(int usec);
+
+    //! Parse the pending conflated messages
+    void flush();
+
+signals:
+    //! Deltas are waiting in the queue
+    void deltasAvailable();
+
+private:
+    typedef nzmqt::ZMQMultipartMessage::Frame Frame;
+
+    //! Parses the payload of a CASU device message
+    typedef void (Ingestor::*DeviceHandler)(int casu, const Frame& data);
+
+    enum TopicKind
+    {
+        CasuTopic,
+        CatsTopic,
+        FishTopic,
+        RibotTopic
+    };
+
+    //! Where messages of a topic go
+    struct Route
+    {
+        TopicKind kind;
+        //! Index of the CASU, for CASU topics
+        int casu;
+        bool conflate;
+        //! Sequence number of the last position batch
+        quint32 sequence;
+        bool sequenced;
+    };
+
+    //! Newest unparsed message of a conflation key
+    struct Slot
+    {
+        Slot() : topic(-1), pending(false) {}
+
+        int topic;
+        bool pending;
+        //! Shares the buffers of the received message
+        nzmqt::ZMQMultipartMessage message;
+    };
+
+    void addTopic(const QByteArray& name, TopicKind kind, int casu = -1);
+    void addDeviceHandler(const QByteArray& device, DeviceHandler handler, bool conflate);
+
+    //! Returns the slot message should be conflated in, or -1 to parse it now
+    int conflationSlot(int topic, const nzmqt::ZMQMultipartMessage& message);
+
+    //! Returns the slot of a conflation key, created on first use
+    int findSlot(int topic, quint32 key);
+
+    //! Parse a message of an interned topic
+    /*!
+     * Returns false if the message is a position batch that has to wait
+     * for room in the queue.
+     */
+    bool dispatch(int topic, const nzmqt::ZMQMultipartMessage& message);
+
+    void handleTemp(int casu, const Frame& data);
+    void handlePeltier(int casu, const Frame& data);
+    void handleIr(int casu, const Frame& data);
+    void handleCommEth(int casu, const Frame& data);
+    void handleCatsMessage(const nzmqt::ZMQMultipartMessage& message);
+    void handlePosition(StateDelta::Type type, const nzmqt::ZMQMultipartMessage& message);
+    //! Returns false, without queueing anything, if the batch does not fit
+    bool handlePositionBatch(StateDelta::Type type, const Frame& data);
+
+    //! Returns true for a binary position batch, see PositionBatch
+    bool isPositionBatch(int topic, const nzmqt::ZMQMultipartMessage& message) const;
+
+    //! Check a batch on arrival, returns false if it is malformed, repeated or late
+    bool acceptBatch(int topic, const Frame& data);
+
+    void push(const StateDelta& delta);
+
+    //! Count a message that could not be parsed, and warn now and then
+    void reportMalformed(const char* what, const Frame& data);
+
+    //! Emit deltasAvailable() if deltas were pushed and the consumer is armed
+    void notify();
+
+    // ZMQ connection details
+    nzmqt::SocketNotifierZMQContext* context_;
+
+    QList<QString> addresses_;
+    QList<QString> topics_;
+
+    nzmqt::ZMQSocket* socket_;
+    int spin_budget_;
+
+    // Dispatch, routes_ and device_handlers_ are indexed by the interned ids
+    NameTable topic_ids_;
+    QVector<Route> routes_;
+    NameTable device_ids_;
+    QVector<DeviceHandler> device_handlers_;
+    QVector<bool> device_conflate_;
+
+    // Conflation, slots are looked up by topic and device or agent id
+    QHash<quint64,int> slot_ids_;
+    QVector<Slot*> slots_;
+    //! Slots holding a message, in arrival order
+    QVector<int> pending_;
+    QTimer flush_timer_;
+
+    // Scanned fields of the sensor payloads
+    WireScanner::Field temp_field_;
+    WireScanner::Field setpoint_field_;
+    WireScanner::Field ir_field_;
+
+    // Fully parsed sensor payloads, reused so their repeated fields keep
+    // their capacity between messages
+    AssisiMsg::TemperatureArray temps_;
+    AssisiMsg::Temperature setpoint_;
+    AssisiMsg::RangeArray ranges_;
+
+    SpscQueue<StateDelta> queue_;
+    std::atomic<bool> wake_pending_;
+    //! Deltas were pushed since the last notify()
+    bool pushed_;
+    std::atomic<quint64> dropped_;
+    std::atomic<quint64> received_;
+    std::atomic<quint64> coalesced_;
+    std::atomic<quint64> malformed_;
+    std::atomic<quint64> lost_batches_;
+};
+
+#endif // INGESTOR_H
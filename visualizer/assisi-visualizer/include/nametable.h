@@ -0,0 +1,46 @@
+#ifndef NAMETABLE_H
+#define NAMETABLE_H
+
+#include <QByteArray>
+#include <QVector>
+
+#include <cstddef>
+
+//! Interns names into dense integer ids
+/*!
+ * Names are added once, e.g. when subscribing, and looked up from raw
+ * bytes (message frames) without allocating: FNV-1a hash, open
+ * addressing with linear probing, at most half full.
+ */
+class NameTable
+{
+public:
+    NameTable();
+
+    //! Returns the id of name, adding it if needed
+    /*!
+     * Ids are assigned in insertion order, starting at 0.
+     */
+    int intern(const QByteArray& name);
+
+    //! Returns the id of the name, -1 if it has not been interned
+    int find(const char* data, std::size_t size) const;
+
+    //! Number of interned names
+    int size() const;
+
+    const QByteArray& name(int id) const;
+
+    static quint32 hash(const char* data, std::size_t size);
+
+private:
+    //! Rebuild the slots with the given capacity, a power of two
+    void rehash(int capacity);
+
+    QVector<QByteArray> names_;
+    QVector<quint32> hashes_;
+    //! Id + 1 of the name in each slot, 0 is empty
+    QVector<int> slots_;
+};
+
+#endif // NAMETABLE_H
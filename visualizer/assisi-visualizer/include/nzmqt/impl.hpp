@@ -30,6 +30,7 @@
 #include "nzmqt/nzmqt.hpp"
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QMutexLocker>
 #include <QSocketNotifier>
 #include <QTimer>
@@ -93,6 +94,89 @@ NZMQT_INLINE QByteArray ZMQMessage::toByteArray()
 
 
 
+/*
+ * ZMQMultipartMessage
+ */
+
+NZMQT_INLINE ZMQMultipartMessage::ZMQMultipartMessage()
+    : m_size(0)
+{
+}
+
+NZMQT_INLINE ZMQMultipartMessage::~ZMQMultipartMessage()
+{
+    qDeleteAll(m_parts);
+}
+
+NZMQT_INLINE int ZMQMultipartMessage::size() const
+{
+    return m_size;
+}
+
+NZMQT_INLINE bool ZMQMultipartMessage::isEmpty() const
+{
+    return m_size == 0;
+}
+
+NZMQT_INLINE ZMQMultipartMessage::Frame ZMQMultipartMessage::frame(int index_) const
+{
+    Q_ASSERT(index_ >= 0 && index_ < m_size);
+    ZMQMessage* part = m_parts[index_];
+    Frame frame = { static_cast<const char*>(part->data()), part->size() };
+    return frame;
+}
+
+NZMQT_INLINE QByteArray ZMQMultipartMessage::toByteArray(int index_) const
+{
+    return m_parts[index_]->toByteArray();
+}
+
+NZMQT_INLINE QList<QByteArray> ZMQMultipartMessage::toByteArrays() const
+{
+    QList<QByteArray> parts;
+    for (int i = 0; i < m_size; i++)
+    {
+        parts += m_parts[i]->toByteArray();
+    }
+    return parts;
+}
+
+NZMQT_INLINE void ZMQMultipartMessage::append(const void* data_, size_t size_)
+{
+    ZMQMessage* part = nextPart();
+    part->rebuild(size_);
+    memcpy(part->data(), data_, size_);
+}
+
+NZMQT_INLINE void ZMQMultipartMessage::clear()
+{
+    for (int i = 0; i < m_size; i++)
+    {
+        m_parts[i]->rebuild();
+    }
+    m_size = 0;
+}
+
+NZMQT_INLINE void ZMQMultipartMessage::copy(const ZMQMultipartMessage& other_)
+{
+    clear();
+    for (int i = 0; i < other_.m_size; i++)
+    {
+        nextPart()->copy(other_.m_parts[i]);
+    }
+}
+
+NZMQT_INLINE ZMQMessage* ZMQMultipartMessage::nextPart()
+{
+    if (m_size == m_parts.size())
+    {
+        m_parts.push_back(new ZMQMessage());
+    }
+    return m_parts[m_size++];
+}
+
+
+
 /*
  * ZMQSocket
  */
@@ -101,6 +185,7 @@ NZMQT_INLINE ZMQSocket::ZMQSocket(ZMQContext* context_, Type type_)
     : qsuper(0)
     , zmqsuper(*context_, type_)
     , m_context(context_)
+    , m_handler(0)
 {
 }
 
@@ -263,6 +348,67 @@ NZMQT_INLINE QList< QList<QByteArray> > ZMQSocket::receiveMessages()
     return ret;
 }
 
+NZMQT_INLINE bool ZMQSocket::receiveMessage(ZMQMultipartMessage* msg_)
+{
+    msg_->clear();
+    forever
+    {
+        ZMQMessage* part = msg_->nextPart();
+        if (!receiveMessage(part))
+        {
+            // Nothing (more) to receive, the part stays unused.
+            msg_->m_size--;
+            break;
+        }
+        if (!part->more())
+            break;
+    }
+    return !msg_->isEmpty();
+}
+
+NZMQT_INLINE void ZMQSocket::setMessageHandler(ZMQMessageHandler* handler_)
+{
+    m_handler = handler_;
+}
+
+NZMQT_INLINE ZMQMessageHandler* ZMQSocket::messageHandler() const
+{
+    return m_handler;
+}
+
+NZMQT_INLINE int ZMQSocket::receiveMessages(int maxMessages_, int timeBudgetUsec_)
+{
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    int count = 0;
+    while (maxMessages_ <= 0 || count < maxMessages_)
+    {
+        // At least one message per call, so every call makes progress.
+        if (timeBudgetUsec_ > 0 && count > 0 && elapsed.nsecsElapsed() > timeBudgetUsec_*qint64(1000))
+            break;
+        if (!receiveMessage(&m_message))
+            break;
+
+        count++;
+        if (m_handler)
+            m_handler->handleMessage(this, m_message);
+        else
+            emit messageReceived(m_message.toByteArrays());
+        // Release the buffers now, not when the next message arrives.
+        m_message.clear();
+    }
+
+    if (count > 0 && m_handler)
+        m_handler->handleBatchEnd(this, count);
+    return count;
+}
+
+NZMQT_INLINE ZMQContext* ZMQSocket::context() const
+{
+    return m_context;
+}
+
 NZMQT_INLINE qintptr ZMQSocket::fileDescriptor() const
 {
     qintptr value;
@@ -377,7 +523,25 @@ NZMQT_INLINE bool ZMQSocket::isConnected()
 NZMQT_INLINE ZMQContext::ZMQContext(QObject* parent_, int io_threads_)
     : qsuper(parent_)
     , zmqsuper(io_threads_)
+    , m_batchMessages(NZMQT_DEFAULT_BATCH_MESSAGES)
+    , m_batchTime(NZMQT_DEFAULT_BATCH_TIME)
+{
+}
+
+NZMQT_INLINE void ZMQContext::setBatchLimits(int maxMessages_, int timeBudgetUsec_)
+{
+    m_batchMessages = maxMessages_;
+    m_batchTime = timeBudgetUsec_;
+}
+
+NZMQT_INLINE int ZMQContext::batchMessageLimit() const
+{
+    return m_batchMessages;
+}
+
+NZMQT_INLINE int ZMQContext::batchTimeLimit() const
 {
+    return m_batchTime;
 }
 
 NZMQT_INLINE ZMQContext::~ZMQContext()
@@ -454,11 +618,6 @@ NZMQT_INLINE PollingZMQSocket::PollingZMQSocket(PollingZMQContext* context_, Typ
 {
 }
 
-NZMQT_INLINE void PollingZMQSocket::onMessageReceived(const QList<QByteArray>& message)
-{
-    emit messageReceived(message);
-}
-
 
 
 /*
@@ -470,6 +629,8 @@ NZMQT_INLINE PollingZMQContext::PollingZMQContext(QObject* parent_, int io_threa
     , m_pollItemsMutex(QMutex::Recursive)
     , m_interval(NZMQT_POLLINGZMQCONTEXT_DEFAULT_POLLINTERVAL)
     , m_stopped(false)
+    , m_pending(false)
+    , m_nextSocket(0)
 {
     setAutoDelete(false);
 }
@@ -515,12 +676,21 @@ NZMQT_INLINE void PollingZMQContext::run()
         emit pollError(ex.num(), ex.what());
     }
 
+    // Left over messages are received in the next turn of the event loop.
     if (!m_stopped)
-        QTimer::singleShot(m_interval, this, SLOT(run()));
+        QTimer::singleShot(m_pending ? 0 : m_interval, this, SLOT(run()));
 }
 
 NZMQT_INLINE void PollingZMQContext::poll(long timeout_)
 {
+    m_pending = false;
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    const int maxMessages = batchMessageLimit();
+    const int timeBudget = batchTimeLimit();
+    int received = 0;
+
     int cnt;
     do {
         QMutexLocker lock(&m_pollItemsMutex);
@@ -533,21 +703,35 @@ NZMQT_INLINE void PollingZMQContext::poll(long timeout_)
         if (0 == cnt)
             return;
 
-        PollItems::iterator poIt = m_pollItems.begin();
-        ZMQContext::Sockets::const_iterator soIt = registeredSockets().begin();
-        int i = 0;
-        while (i < cnt && poIt != m_pollItems.end())
+        // Every ready socket gets its share of the batch limits, and the
+        // turns start one socket further on every pass, so a busy socket
+        // cannot starve the ones after it.
+        const int share = maxMessages > 0 ? qMax(1, maxMessages/cnt) : 0;
+        const int timeShare = timeBudget > 0 ? qMax(1, timeBudget/cnt) : 0;
+
+        const ZMQContext::Sockets& sockets = registeredSockets();
+        const int n = m_pollItems.size();
+        const int first = m_nextSocket % n;
+        int served = 0;
+        for (int k = 0; k < n && served < cnt; k++)
         {
-            if (poIt->revents & ZMQSocket::EVT_POLLIN)
+            int index = (first + k) % n;
+            if (!(m_pollItems[index].revents & ZMQSocket::EVT_POLLIN))
+                continue;
+
+            qint64 used = elapsed.nsecsElapsed()/1000;
+            if ((maxMessages > 0 && received >= maxMessages) || (timeBudget > 0 && used >= timeBudget))
             {
-                PollingZMQSocket* socket = static_cast<PollingZMQSocket*>(*soIt);
-                QList<QByteArray> message = socket->receiveMessage();
-                socket->onMessageReceived(message);
-                i++;
+                // The next poll starts with the socket that missed its turn.
+                m_nextSocket = index;
+                m_pending = true;
+                return;
             }
-            ++soIt;
-            ++poIt;
+            int budget = timeBudget > 0 ? int(qMin<qint64>(timeShare, timeBudget - used)) : 0;
+            received += sockets.at(index)->receiveMessages(share, budget);
+            served++;
         }
+        m_nextSocket = (first + 1) % n;
     } while (cnt > 0);
 }
 
@@ -596,15 +780,18 @@ NZMQT_INLINE void PollingZMQContext::unregisterSocket(ZMQSocket* socket_)
 NZMQT_INLINE SocketNotifierZMQSocket::SocketNotifierZMQSocket(ZMQContext* context_, Type type_)
     : super(context_, type_)
     , socketNotifyRead_(0)
-    , socketNotifyWrite_(0)
+    , m_spinBudget(0)
+    , m_writeNotification(false)
 {
     qintptr fd = fileDescriptor();
 
+    // The ZMQ file descriptor only ever signals readability, for both directions.
+    // A write notifier on it would fire continuously.
     socketNotifyRead_ = new QSocketNotifier(fd, QSocketNotifier::Read, this);
     QObject::connect(socketNotifyRead_, SIGNAL(activated(int)), this, SLOT(socketReadActivity()));
 
-    socketNotifyWrite_ = new QSocketNotifier(fd, QSocketNotifier::Write, this);
-    QObject::connect(socketNotifyWrite_, SIGNAL(activated(int)), this, SLOT(socketWriteActivity()));
+    // Messages that arrive before the notifier is watched raise no edge.
+    QMetaObject::invokeMethod(this, "socketReadActivity", Qt::QueuedConnection);
 }
 
 NZMQT_INLINE SocketNotifierZMQSocket::~SocketNotifierZMQSocket()
@@ -614,21 +801,92 @@ NZMQT_INLINE SocketNotifierZMQSocket::~SocketNotifierZMQSocket()
 
 NZMQT_INLINE void SocketNotifierZMQSocket::close()
 {
-    socketNotifyRead_->deleteLater();
-    socketNotifyWrite_->deleteLater();
+    if (socketNotifyRead_)
+    {
+        socketNotifyRead_->setEnabled(false);
+        socketNotifyRead_->deleteLater();
+        socketNotifyRead_ = 0;
+    }
     super::close();
 }
 
+NZMQT_INLINE void SocketNotifierZMQSocket::setSpinBudget(int usec_)
+{
+    m_spinBudget = usec_;
+}
+
+NZMQT_INLINE int SocketNotifierZMQSocket::spinBudget() const
+{
+    return m_spinBudget;
+}
+
+NZMQT_INLINE void SocketNotifierZMQSocket::setWriteNotificationEnabled(bool enabled_)
+{
+    m_writeNotification = enabled_;
+    if (m_writeNotification)
+    {
+        // The socket may already be writable, which raises no new edge.
+        QMetaObject::invokeMethod(this, "socketWriteActivity", Qt::QueuedConnection);
+    }
+}
+
 NZMQT_INLINE void SocketNotifierZMQSocket::socketReadActivity()
 {
+    if (!socketNotifyRead_)
+        return;
+
     socketNotifyRead_->setEnabled(false);
 
+    bool resume = false;
     try
     {
-        while(isConnected() && (events() & EVT_POLLIN))
+        const int maxMessages = context() ? context()->batchMessageLimit() : 0;
+        const int timeBudget = context() ? context()->batchTimeLimit() : 0;
+        QElapsedTimer elapsed;
+        elapsed.start();
+        int received = 0;
+
+        QElapsedTimer spin;
+        bool spinning = false;
+        bool wasWritable = false;
+        while (isConnected())
         {
-            QList<QByteArray> message = receiveMessage();
-            emit messageReceived(message);
+            Events evts = events();
+            if (m_writeNotification && (evts & EVT_POLLOUT) && !wasWritable)
+            {
+                emit readyToSend();
+            }
+            wasWritable = evts & EVT_POLLOUT;
+
+            if (evts & EVT_POLLIN)
+            {
+                qint64 used = elapsed.nsecsElapsed()/1000;
+                if ((maxMessages > 0 && received >= maxMessages) || (timeBudget > 0 && used >= timeBudget))
+                {
+                    // Let the event loop run, the edge has been consumed so
+                    // continuing is up to us.
+                    resume = true;
+                    break;
+                }
+                received += receiveMessages(maxMessages > 0 ? maxMessages - received : 0,
+                                            timeBudget > 0 ? int(timeBudget - used) : 0);
+                spinning = false;
+                continue;
+            }
+
+            // Drained. Optionally keep checking for a while, a message arriving
+            // now is handled without a trip through the event loop.
+            if (m_spinBudget <= 0)
+                break;
+            if (!spinning)
+            {
+                spin.start();
+                spinning = true;
+            }
+            else if (spin.nsecsElapsed() > m_spinBudget*qint64(1000))
+            {
+                break;
+            }
         }
     }
     catch (const ZMQException& ex)
@@ -637,19 +895,25 @@ NZMQT_INLINE void SocketNotifierZMQSocket::socketReadActivity()
         emit notifierError(ex.num(), ex.what());
     }
 
-    socketNotifyRead_->setEnabled(true);
+    // The handlers may have closed the socket.
+    if (socketNotifyRead_)
+    {
+        socketNotifyRead_->setEnabled(true);
+        if (resume)
+            QMetaObject::invokeMethod(this, "socketReadActivity", Qt::QueuedConnection);
+    }
 }
 
 NZMQT_INLINE void SocketNotifierZMQSocket::socketWriteActivity()
 {
-    socketNotifyWrite_->setEnabled(false);
+    if (!socketNotifyRead_)
+        return;
 
     try
     {
-        while (isConnected() && (events() & EVT_POLLIN))
+        if (m_writeNotification && isConnected() && (events() & EVT_POLLOUT))
         {
-            QList<QByteArray> message = receiveMessage();
-            emit messageReceived(message);
+            emit readyToSend();
         }
     }
     catch (const ZMQException& ex)
@@ -658,7 +922,9 @@ NZMQT_INLINE void SocketNotifierZMQSocket::socketWriteActivity()
         emit notifierError(ex.num(), ex.what());
     }
 
-    socketNotifyWrite_->setEnabled(true);
+    // Querying the events consumed the edge, so pending input has to be
+    // handled now as well.
+    socketReadActivity();
 }
 
 
@@ -669,6 +935,7 @@ NZMQT_INLINE void SocketNotifierZMQSocket::socketWriteActivity()
 
 NZMQT_INLINE SocketNotifierZMQContext::SocketNotifierZMQContext(QObject* parent_, int io_threads_)
     : super(parent_, io_threads_)
+    , m_spinBudget(0)
 {
 }
 
@@ -685,9 +952,24 @@ NZMQT_INLINE bool SocketNotifierZMQContext::isStopped() const
     return false;
 }
 
+NZMQT_INLINE void SocketNotifierZMQContext::setSpinBudget(int usec_)
+{
+    m_spinBudget = usec_;
+    foreach (ZMQSocket* socket, registeredSockets())
+    {
+        static_cast<SocketNotifierZMQSocket*>(socket)->setSpinBudget(usec_);
+    }
+}
+
+NZMQT_INLINE int SocketNotifierZMQContext::spinBudget() const
+{
+    return m_spinBudget;
+}
+
 NZMQT_INLINE SocketNotifierZMQSocket* SocketNotifierZMQContext::createSocketInternal(ZMQSocket::Type type_)
 {
     SocketNotifierZMQSocket *socket = new SocketNotifierZMQSocket(this, type_);
+    socket->setSpinBudget(m_spinBudget);
     connect(socket, SIGNAL(notifierError(int,QString)),
             this, SIGNAL(notifierError(int,QString)));
     return socket;
@@ -56,6 +56,14 @@
     #define NZMQT_POLLINGZMQCONTEXT_DEFAULT_POLLINTERVAL 10 /* msec */
 #endif
 
+// Define default limits of the messages received per event loop turn.
+#ifndef NZMQT_DEFAULT_BATCH_MESSAGES
+    #define NZMQT_DEFAULT_BATCH_MESSAGES 256
+#endif
+#ifndef NZMQT_DEFAULT_BATCH_TIME
+    #define NZMQT_DEFAULT_BATCH_TIME 5000 /* usec */
+#endif
+
 class QSocketNotifier;
 
 namespace nzmqt
@@ -101,6 +109,80 @@ namespace nzmqt
         QByteArray toByteArray();
     };
 
+    // A received multi-part message. The parts keep the buffers ZMQ received
+    // them into, and can be read in place. Instances are meant to be reused:
+    // receiving into a message recycles its part objects, so receiving does not
+    // allocate once the message has seen its largest number of parts.
+    class NZMQT_API ZMQMultipartMessage
+    {
+        friend class ZMQSocket;
+
+    public:
+        // Read only view of a message part. It is valid until the message is
+        // received into again, cleared or destroyed.
+        struct Frame
+        {
+            const char* data;
+            size_t size;
+        };
+
+        ZMQMultipartMessage();
+
+        ~ZMQMultipartMessage();
+
+        // Returns the number of parts.
+        int size() const;
+
+        bool isEmpty() const;
+
+        Frame frame(int index_) const;
+
+        // Copies a part, for consumers that need byte arrays.
+        QByteArray toByteArray(int index_) const;
+
+        QList<QByteArray> toByteArrays() const;
+
+        // Appends a copy of the given bytes as a new part.
+        void append(const void* data_, size_t size_);
+
+        // Releases the buffers of all parts, keeps the part objects for reuse.
+        void clear();
+
+        // Makes this message share the parts of other_. Large parts are
+        // reference counted by ZMQ, so their buffers are not copied.
+        void copy(const ZMQMultipartMessage& other_);
+
+    private:
+        Q_DISABLE_COPY(ZMQMultipartMessage)
+
+        // Returns the next unused part object.
+        ZMQMessage* nextPart();
+
+        QVector<ZMQMessage*> m_parts;
+        int m_size;
+    };
+
+    class ZMQSocket;
+
+    // Receives messages in place, see ZMQSocket::setMessageHandler().
+    class NZMQT_API ZMQMessageHandler
+    {
+    public:
+        virtual ~ZMQMessageHandler() {}
+
+        // Called in the socket's thread. The message and its frames are only
+        // valid during the call.
+        virtual void handleMessage(ZMQSocket* socket_, const ZMQMultipartMessage& message_) = 0;
+
+        // Called once after a batch of messages has been handled, see
+        // ZMQSocket::receiveMessages(int, int).
+        virtual void handleBatchEnd(ZMQSocket* socket_, int messages_)
+        {
+            Q_UNUSED(socket_);
+            Q_UNUSED(messages_);
+        }
+    };
+
     class ZMQContext;
 
     // This class cannot be instantiated. Its purpose is to serve as an
@@ -235,6 +317,25 @@ namespace nzmqt
         // Note that this method won't work with REQ-REP protocol.
         QList< QList<QByteArray> > receiveMessages();
 
+        // Receives all parts of a message into the given message object, reusing
+        // its part objects. Returns false if no message was available.
+        bool receiveMessage(ZMQMultipartMessage* msg_);
+
+        // Delivers received messages to the handler instead of emitting the
+        // messageReceived() signal, without copying them. Pass 0 to go back to
+        // the signal. The handler is not owned by the socket.
+        void setMessageHandler(ZMQMessageHandler* handler_);
+
+        ZMQMessageHandler* messageHandler() const;
+
+        // Receives and delivers the available messages, but at most maxMessages_
+        // of them, and for at most timeBudgetUsec_ microseconds. 0 means no limit.
+        // Messages are passed to the message handler, followed by a single
+        // handleBatchEnd() call, or emitted one by one as messageReceived() if
+        // there is no handler. Returns the number of messages delivered.
+        // Called by the contexts when the socket is readable.
+        int receiveMessages(int maxMessages_, int timeBudgetUsec_);
+
         qintptr fileDescriptor() const;
 
         Events events() const;
@@ -291,10 +392,16 @@ namespace nzmqt
     protected:
         ZMQSocket(ZMQContext* context_, Type type_);
 
+        // Returns 0 once the context has been destroyed.
+        ZMQContext* context() const;
+
     private:
         friend class ZMQContext;
 
         ZMQContext* m_context;
+        ZMQMessageHandler* m_handler;
+        // Reused for every delivered message.
+        ZMQMultipartMessage m_message;
     };
     Q_DECLARE_OPERATORS_FOR_FLAGS(ZMQSocket::Events)
     Q_DECLARE_OPERATORS_FOR_FLAGS(ZMQSocket::SendFlags)
@@ -338,6 +445,16 @@ namespace nzmqt
         // Indicates if watching for incoming messages is enabled.
         virtual bool isStopped() const = 0;
 
+        // Limits the messages received in one turn of the event loop, in number
+        // and in time (microseconds), 0 meaning no limit. Messages left over are
+        // received in the next turn, so a burst cannot starve painting, timers or
+        // other sockets.
+        void setBatchLimits(int maxMessages_, int timeBudgetUsec_);
+
+        int batchMessageLimit() const;
+
+        int batchTimeLimit() const;
+
     protected:
         typedef QVector<ZMQSocket*> Sockets;
 
@@ -353,6 +470,8 @@ namespace nzmqt
 
     private:
         Sockets m_sockets;
+        int m_batchMessages;
+        int m_batchTime;
     };
 
 /*
@@ -394,10 +513,6 @@ namespace nzmqt
 
     protected:
         PollingZMQSocket(PollingZMQContext* context_, Type type_);
-
-        // This method is called by the socket's context object in order
-        // to signal a new received message.
-        void onMessageReceived(const QList<QByteArray>& message);
     };
 
     class NZMQT_API PollingZMQContext : public ZMQContext, public QRunnable
@@ -436,6 +551,9 @@ namespace nzmqt
         // using the given timeout to wait for incoming messages. Note that this timeout has
         // nothing to do with the polling interval. Instead, the poll method will block the current
         // thread by waiting at most the specified amount of time for incoming messages.
+        // Ready sockets are served in turns, each receiving an equal share of the batch
+        // limits, starting with a different socket on every pass.
+        // If the limits are reached, run() resumes without waiting for the interval.
         // This method is public because it can be called directly if you need to.
         void poll(long timeout_ = 0);
 
@@ -460,6 +578,10 @@ namespace nzmqt
         QMutex m_pollItemsMutex;
         int m_interval;
         volatile bool m_stopped;
+        // Messages were left over by the last poll.
+        bool m_pending;
+        // Index of the socket served first by the next poll.
+        int m_nextSocket;
     };
 
 
@@ -478,22 +600,43 @@ namespace nzmqt
 
         void close();
 
+        // Sets the time, in microseconds, the socket keeps checking for new messages
+        // after it has been drained, before it returns to the event loop. Spinning
+        // trades CPU time for latency, 0 (the default) disables it.
+        void setSpinBudget(int usec_);
+
+        int spinBudget() const;
+
+        // Enables the readyToSend() signal. It is disabled by default, because
+        // most sockets can always send.
+        void setWriteNotificationEnabled(bool enabled_);
+
     signals:
         // This signal will be emitted by the socket notifier callback if a call
         // to the events() method results in an exception.
         void notifierError(int errorNum, const QString& errorMsg);
 
+        // This signal is emitted when the socket can send, if write notification
+        // is enabled.
+        void readyToSend();
+
     protected:
         SocketNotifierZMQSocket(ZMQContext* context_, Type type_);
         ~SocketNotifierZMQSocket();
 
     protected slots:
+        // The ZMQ file descriptor is edge triggered, and becomes readable whenever
+        // the socket's ZMQ_EVENTS change, for reading or for writing. Both slots
+        // therefore check all events, and receive until EVT_POLLIN clears, as no
+        // further notification arrives while messages are left. Once the context's
+        // batch limits are reached, receiving resumes in the next event loop turn.
         void socketReadActivity();
         void socketWriteActivity();
 
     private:
         QSocketNotifier *socketNotifyRead_;
-        QSocketNotifier *socketNotifyWrite_;
+        int m_spinBudget;
+        bool m_writeNotification;
     };
 
     class NZMQT_API SocketNotifierZMQContext : public ZMQContext
@@ -511,6 +654,12 @@ namespace nzmqt
 
         bool isStopped() const;
 
+        // Sets the spin budget, in microseconds, of all current and future sockets.
+        // See SocketNotifierZMQSocket::setSpinBudget().
+        void setSpinBudget(int usec_);
+
+        int spinBudget() const;
+
     signals:
         // This signal will be emitted by the socket notifier callback if a call
         // to the events() method results in an exception.
@@ -518,6 +667,9 @@ namespace nzmqt
 
     protected:
         SocketNotifierZMQSocket* createSocketInternal(ZMQSocket::Type type_);
+
+    private:
+        int m_spinBudget;
     };
 
     NZMQT_API inline ZMQContext* createDefaultContext(QObject* parent_ = 0, int io_threads_ = NZMQT_DEFAULT_IOTHREADS)
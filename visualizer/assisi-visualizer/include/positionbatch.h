@@ -0,0 +1,65 @@
+#ifndef POSITIONBATCH_H
+#define POSITIONBATCH_H
+
+#include <QByteArray>
+#include <QVector>
+
+#include <cstddef>
+
+//! Binary batch of tracked positions, one frame per tracker tick
+/*!
+ * Sent as <FishPosition|CASUPosition><batch>, replacing one four frame
+ * text message per agent. Layout, little endian, no padding:
+ *
+ *     uint32  sequence     incremented for every batch
+ *     int64   timestamp    tracker time, in microseconds
+ *     uint16  count        number of records
+ *     uint16  reserved     0
+ *     count records of
+ *         int32   id
+ *         float32 x, y     tracker coordinates, in [0,500]
+ *         float32 heading  radians, counterclockwise from the x axis, NaN if unknown
+ *
+ * Records are read in place from the frame.
+ */
+class PositionBatch
+{
+public:
+    struct Record
+    {
+        int id;
+        float x;
+        float y;
+        float heading;
+    };
+
+    static const int header_size = 16;
+    static const int record_size = 16;
+
+    PositionBatch();
+
+    //! Read the header of a batch frame
+    /*!
+     * Returns false if the frame is too short for its count. data has to
+     * outlive the batch.
+     */
+    bool read(const char* data, std::size_t size);
+
+    quint32 sequence() const;
+    qint64 timestamp() const;
+    int count() const;
+
+    //! Returns the record at index, 0 <= index < count()
+    Record record(int index) const;
+
+    //! Encode a batch, for publishers and benchmarks
+    static QByteArray write(quint32 sequence, qint64 timestamp, const QVector<Record>& records);
+
+private:
+    const unsigned char* data_;
+    quint32 sequence_;
+    qint64 timestamp_;
+    int count_;
+};
+
+#endif // POSITIONBATCH_H
@@ -0,0 +1,54 @@
+#ifndef RENDERBENCHMARK_H
+#define RENDERBENCHMARK_H
+
+#include "benchmark.h"
+#include "scene.h"
+
+#include <QSize>
+#include <QString>
+
+//! Renders synthetic scenes without a display and reports frame times
+/*!
+ * Uses the same SceneRenderer as the render thread, so every rendering
+ * optimization can be measured on a machine without GPU or monitor
+ * (run with the offscreen Qt platform).
+ */
+class RenderBenchmark : public Benchmark
+{
+public:
+    struct Options
+    {
+        //! Defaults match the Ars Electronica setup
+        Options();
+
+        int frames;
+        int fish;
+        int ribots;
+        int casus;
+        //! Frame size in device independent pixels
+        QSize size;
+        qreal dpr;
+        //! If not empty, every frame is saved as png into this directory
+        QString dump_dir;
+    };
+
+    explicit RenderBenchmark(const Options& options);
+
+    //! Render all frames and print the statistics
+    int run();
+
+    //! Layout with casus CASUs placed on a grid in the bee arena
+    static SceneLayout layout(int casus);
+
+    //! Synthetic state of the given frame
+    /*!
+     * Agents swim around the tank, CASU readings change,
+     * and all message animations are active.
+     */
+    static SceneState state(const SceneLayout& layout, const Options& options, int frame);
+
+private:
+    Options options_;
+};
+
+#endif // RENDERBENCHMARK_H
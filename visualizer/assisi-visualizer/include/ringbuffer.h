@@ -0,0 +1,85 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+//! Fixed capacity history of the last N values
+/*!
+ * Appending is O(1) and never allocates, the storage is part of the
+ * object. Every value is stored twice, N elements apart, so that the last
+ * n values are always contiguous in memory and can be read as a plain
+ * array, oldest first, without wrapping around.
+ *
+ * T is copied, so it should be small and trivially copyable.
+ */
+template <typename T, int N>
+class RingBuffer
+{
+    static_assert(N > 0, "RingBuffer needs a capacity");
+
+public:
+    RingBuffer()
+        : next_(0),
+          size_(0)
+    {
+
+    }
+
+    static int capacity()
+    {
+        return N;
+    }
+
+    //! Number of values, at most capacity()
+    int size() const
+    {
+        return size_;
+    }
+
+    bool isEmpty() const
+    {
+        return size_ == 0;
+    }
+
+    void clear()
+    {
+        next_ = 0;
+        size_ = 0;
+    }
+
+    //! Append value, dropping the oldest one if the buffer is full
+    void push(const T& value)
+    {
+        data_[next_] = value;
+        data_[next_ + N] = value;
+        next_ = (next_ + 1 == N ? 0 : next_ + 1);
+        if (size_ < N)
+        {
+            size_++;
+        }
+    }
+
+    //! Returns the value age appends ago, 0 is the newest, age < size()
+    const T& at(int age) const
+    {
+        return data_[next_ + N - 1 - age];
+    }
+
+    //! Returns the newest value, the buffer must not be empty
+    const T& newest() const
+    {
+        return at(0);
+    }
+
+    //! Returns the last n values as an array, oldest first, n <= size()
+    const T* last(int n) const
+    {
+        return data_ + next_ + N - n;
+    }
+
+private:
+    T data_[2*N];
+    //! Where the next value goes, in [0,N)
+    int next_;
+    int size_;
+};
+
+#endif // RINGBUFFER_H
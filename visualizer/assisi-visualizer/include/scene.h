@@ -0,0 +1,116 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <QImage>
+#include <QMetaType>
+#include <QRect>
+#include <QRectF>
+#include <QString>
+#include <QVector>
+
+#include <algorithm>
+#include <vector>
+
+//! Static placement of all scene items, in scene coordinates
+struct SceneLayout
+{
+    //! Initialize the Ars Electronica setup
+    SceneLayout();
+
+    struct Casu
+    {
+        QString name;
+        QRect body;
+        QRect heating_area;
+    };
+
+    // Scene dimensions
+    qreal width;
+    qreal height;
+
+    // Fish tank dimensions
+    QRect fish_tank_outer;
+    QRect fish_tank_inner;
+
+    // Bee arena dimensions
+    QRect bee_arena;
+    QVector<Casu> casus;
+
+    // Communication arrow dimensions
+    QRect double_arrow;
+    QRect top_arrow;
+    QRect bottom_arrow;
+};
+
+//! Immutable copy of everything that is displayed
+/*!
+ * Taken on the GUI thread and handed over to the renderer,
+ * so that painting never touches the Subscriber data.
+ */
+struct SceneState
+{
+    SceneState();
+
+    //! Message sent from a CASU to CATS
+    struct Message
+    {
+        Message();
+
+        bool active;
+        int count;
+        QRectF pose;
+    };
+
+    //! CATS message sent to both CASUs
+    struct CatsMessage
+    {
+        CatsMessage();
+
+        bool active;
+        int fish_direction;
+        int ribot_direction;
+        double rot_fish;
+        double rot_ribot;
+        QRectF pose_top;
+        QRectF pose_bot;
+        QRectF ribot_dir_top;
+        QRectF ribot_dir_bot;
+        QRectF fish_dir_top;
+        QRectF fish_dir_bot;
+    };
+
+    struct Casu
+    {
+        Casu();
+
+        double temp;
+        double temp_ref;
+        std::vector<double> ir_ranges;
+        Message msg;
+    };
+
+    //! Same order as SceneLayout::casus
+    QVector<Casu> casus;
+
+    QVector<QRectF> fish;
+    QVector<QRectF> ribots;
+    //! Swimming directions, +1 is CCW, -1 is CW
+    int fish_direction;
+    int ribot_direction;
+
+    //! Colour mapped fish occupancy, to be scaled onto fish_density_area
+    QImage fish_density;
+    QRectF fish_density_area;
+
+    CatsMessage cats_msg;
+};
+
+Q_DECLARE_METATYPE(SceneState)
+
+template <typename T>
+T clip(T x, T lower, T upper)
+{
+    return std::max(lower, std::min(x, upper));
+}
+
+#endif // SCENE_H
@@ -0,0 +1,61 @@
+#ifndef SCENERENDERER_H
+#define SCENERENDERER_H
+
+#include "scene.h"
+#include "spriteatlas.h"
+#include "spritebatch.h"
+
+#include <QColor>
+#include <QImage>
+#include <QRegion>
+
+class QPainter;
+
+//! Paints a scene state
+/*!
+ * Does not depend on any widget, so it can be used from a render
+ * thread or without a display.
+ */
+class SceneRenderer
+{
+public:
+    explicit SceneRenderer(const SceneLayout& layout);
+
+    //! Paint the state into the region of the target image
+    /*!
+     * The target is expected to cover the whole scene. Its device pixel
+     * ratio is honoured, the region is given in device independent pixels.
+     * Pixels outside of the region are left untouched.
+     */
+    void render(QImage& target, const SceneState& state, const QRegion& region);
+
+    static QColor tempToColor(double temp);
+    static double tempToAngle(double temp);
+
+protected:
+    //! Render the layers that do not change between frames
+    /*!
+     * Called whenever the target size or device pixel ratio changes.
+     */
+    void renderStaticLayers(const QSize& size, qreal dpr);
+    void drawRotatedSprite(QPainter& painter,
+                           const QRectF& area,
+                           double angle,
+                           const QString& resource_name);
+
+private:
+    SceneLayout layout_;
+
+    //! Rasterized artwork
+    SpriteAtlas atlas_;
+    //! Fish and ribots, drawn in one pass
+    SpriteBatch agents_;
+    int fish_sprites_[2];
+    int ribot_sprites_[2];
+
+    // Static layers, composited below and above the dynamic items
+    QImage background_;
+    QImage overlay_;
+};
+
+#endif // SCENERENDERER_H
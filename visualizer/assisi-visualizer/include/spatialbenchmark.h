@@ -0,0 +1,27 @@
+#ifndef SPATIALBENCHMARK_H
+#define SPATIALBENCHMARK_H
+
+#include "benchmark.h"
+
+//! Times the per frame neighbour work for a large shoal
+/*!
+ * Synthetic agents swim around the tank and are committed to an
+ * EntityStore at 30 Hz. Every frame the spatial index is rebuilt, the
+ * shoal metrics are computed, and a number of picks and radius queries
+ * are run, as the visualizer would. The time per frame is printed and
+ * compared to the budget.
+ */
+class SpatialBenchmark : public Benchmark
+{
+public:
+    explicit SpatialBenchmark(int agents);
+
+    //! Run the frames and print the statistics, fails if over budget
+    int run();
+
+private:
+    //! Number of agents
+    int agents_;
+};
+
+#endif // SPATIALBENCHMARK_H
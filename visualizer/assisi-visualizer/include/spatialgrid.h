@@ -0,0 +1,79 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <vector>
+
+//! Uniform grid over a set of points, for neighbour queries
+/*!
+ * The grid is rebuilt from position arrays with a counting sort: points
+ * are binned into square cells, and stored cell by cell in contiguous
+ * arrays, so a query reads a few short runs of memory. Rebuilding is
+ * linear in the number of points and does not allocate once the arrays
+ * have grown to size.
+ *
+ * The grid covers the bounding box of the points, with cells sized for a
+ * few points each, so the cost of a query does not depend on the number
+ * of points or the coordinate space they are in.
+ *
+ * The grid is not updated point by point: the tracker moves every agent
+ * on every tick, so an incremental update would touch all points anyway,
+ * and move them between cells of varying size. A rebuild of 5000 points
+ * is a few passes over flat arrays, about 40 us.
+ */
+class SpatialGrid
+{
+public:
+    SpatialGrid();
+
+    //! Index count points, points with a NaN or infinite coordinate are left out
+    void rebuild(const double* xs, const double* ys, int count);
+
+    //! Number of indexed points
+    int size() const;
+
+    //! Returns the point closest to (x, y), at most max_distance away, or -1
+    int pick(double x, double y, double max_distance) const;
+
+    //! Find the points at most distance away from (x, y), in no particular order
+    /*!
+     * found is cleared first. Returns the number of points found.
+     */
+    int radius(double x, double y, double distance, std::vector<int>* found) const;
+
+    //! Find the k points closest to (x, y), closest first
+    /*!
+     * found and distances have room for k entries. The point exclude,
+     * e.g. the query point itself, is skipped. Returns the number of
+     * points found, less than k if there are not enough points.
+     */
+    int nearest(double x, double y, int k, int* found, double* distances, int exclude = -1) const;
+
+private:
+    int cellX(double x) const;
+    int cellY(double y) const;
+
+    //! Insert a point closer than the farthest into the sorted k nearest, n of which are filled
+    static void offer(int point, double d2, int k, int* found, double* d2s, int* n);
+
+    //! Offer the sorted entries begin to end - 1 for nearest()
+    void scanEntries(int begin, int end, double x, double y, int k, int* found, double* d2s, int* n,
+                     int exclude) const;
+
+    double x0_;
+    double y0_;
+    double cell_size_;
+    int cols_;
+    int rows_;
+
+    //! Points of cell c are entries cell_start_[c] to cell_start_[c+1] - 1
+    std::vector<int> cell_start_;
+    // Points sorted by cell
+    std::vector<int> points_;
+    std::vector<double> x_;
+    std::vector<double> y_;
+    //! Cell of every input point, -1 if left out
+    std::vector<int> point_cell_;
+    int size_;
+};
+
+#endif // SPATIALGRID_H
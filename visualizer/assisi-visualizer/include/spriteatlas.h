@@ -0,0 +1,125 @@
+#ifndef SPRITEATLAS_H
+#define SPRITEATLAS_H
+
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+class QPainter;
+class QSvgRenderer;
+
+//! Cache of rasterized svg artwork
+/*!
+ * Every svg resource is parsed exactly once, when the atlas is loaded.
+ * Sprites are rasterized on first use to premultiplied ARGB images at the
+ * current device scale, and then only blitted. The rasters are dropped and
+ * recreated only when the device scale changes (window resize, DPI change).
+ *
+ * Sprites are looked up by resource base name, e.g. "fish-ccw" for
+ * ":/artwork/fish-ccw.svg".
+ *
+ * Rotated sprites are kept in rotation sheets: one frame per multiple of
+ * the angular resolution, rendered from the vector artwork. The sprite is
+ * rotated in scene coordinates, and frames are rendered at a uniform scale,
+ * the larger of both device scales, so the non-uniform scene to device
+ * scaling is applied after the rotation, when the frame is blitted. Frames are
+ * rendered on first use, so a sheet costs memory only for the angles
+ * that are actually displayed. Once the sheets exceed their memory budget,
+ * further angles are drawn by rotating the upright raster instead.
+ */
+class SpriteAtlas
+{
+public:
+    SpriteAtlas();
+    ~SpriteAtlas();
+
+    //! Parse all svg resources found under prefix
+    void loadResources(const QString& prefix = QString(":/artwork"));
+
+    //! Set the scene to device pixel scaling
+    /*!
+     * Includes the device pixel ratio.
+     * Returns true if the cached rasters had to be dropped.
+     */
+    bool setScale(double scale_x, double scale_y);
+
+    //! Returns the sprite rasterized for the given scene size
+    /*!
+     * Returns a null image if the resource is unknown.
+     */
+    const QImage& sprite(const QString& name, const QSizeF& size);
+
+    //! Blit the sprite into the area, given in scene coordinates
+    void draw(QPainter& painter, const QString& name, const QRectF& area);
+
+    //! Set the angle between two frames of a rotation sheet, in degrees
+    /*!
+     * Frames are spaced evenly over a full turn, so the angle used is
+     * rounded down to 360 divided by a whole number of frames.
+     */
+    void setAngularResolution(double degrees);
+    double angularResolution() const;
+
+    //! Set the memory budget of all rotation sheets, in bytes
+    void setRotationCacheLimit(qint64 bytes);
+
+    //! Returns the sprite rotated by the nearest frame angle
+    /*!
+     * angle is in degrees, clockwise. The image is square, centered on
+     * the center of the sprite, and scaled by sheetScale() in both
+     * directions. Returns a null image if the resource is unknown, or if
+     * the frame does not fit in the memory budget.
+     */
+    const QImage& rotatedSprite(const QString& name, const QSizeF& size, double angle);
+
+    //! Blit the sprite rotated around the center of the area
+    void drawRotated(QPainter& painter, const QString& name, const QRectF& area, double angle);
+
+    //! Scene to pixel scaling of rotation sheet frames, the same in both directions
+    double sheetScale() const;
+
+    //! Returns true if a resource with this name has been loaded
+    bool contains(const QString& name) const;
+
+private:
+    typedef QPair<QSize,QImage> Raster;
+
+    struct RotationSheet
+    {
+        //! Size of the upright sprite, scaled by sheetScale()
+        QSize size;
+        //! One frame per angle, null until first used
+        QVector<QImage> frames;
+    };
+
+    struct Sprite
+    {
+        Sprite();
+
+        QSvgRenderer* renderer;
+        //! Rasters of this sprite, one per requested device size
+        QList<Raster> rasters;
+        //! Rotation sheets of this sprite, one per requested device size
+        QList<RotationSheet> sheets;
+    };
+
+    QSize deviceSize(const QSizeF& size) const;
+
+    //! Drop all rotation sheets
+    void clearSheets();
+
+    QHash<QString,Sprite> sprites_;
+    QImage null_image_;
+
+    double scale_x_;
+    double scale_y_;
+
+    double angular_resolution_;
+    qint64 sheet_bytes_;
+    qint64 sheet_bytes_limit_;
+};
+
+#endif // SPRITEATLAS_H
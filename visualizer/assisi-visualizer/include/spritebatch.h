@@ -0,0 +1,67 @@
+#ifndef SPRITEBATCH_H
+#define SPRITEBATCH_H
+
+#include <QPointF>
+#include <QSizeF>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QPainter;
+class SpriteAtlas;
+
+//! Collects sprite instances and draws them in one pass per sprite
+/*!
+ * Instances are bucketed by sprite, so every sprite image is looked up
+ * once per frame, and the painter state is set up once per bucket.
+ * Unrotated instances are blitted 1:1 at device pixel positions, which
+ * is the fastest path of the raster engine. Rotated instances are blitted
+ * from the atlas rotation sheets the same way, and only scaled when the
+ * scene is stretched unevenly to the device. This is what
+ * QPainter::drawPixmapFragments() does, but works on QImages, which
+ * (unlike QPixmaps) can be used from the render thread.
+ */
+class SpriteBatch
+{
+public:
+    struct Instance
+    {
+        //! Position of the sprite center, in scene coordinates
+        QPointF center;
+        //! Size in scene coordinates
+        QSizeF size;
+        //! Rotation in degrees, clockwise
+        double rotation;
+        //! 0.0 is transparent, 1.0 is opaque
+        double opacity;
+        int sprite;
+    };
+
+    explicit SpriteBatch(SpriteAtlas& atlas);
+
+    //! Returns the id used to add instances of the named sprite
+    int spriteId(const QString& name);
+
+    //! Drop all instances, keeps the allocated memory
+    void clear();
+
+    void add(int sprite, const QRectF& area, double rotation = 0.0, double opacity = 1.0);
+
+    //! Number of instances added since the last clear()
+    int size() const;
+
+    //! Draw all instances with the current painter transformation
+    void draw(QPainter& painter);
+
+private:
+    SpriteAtlas& atlas_;
+
+    QStringList sprites_;
+    QVector<Instance> instances_;
+
+    // Bucketing, reused between frames
+    QVector<int> bucket_start_;
+    QVector<int> order_;
+};
+
+#endif // SPRITEBATCH_H
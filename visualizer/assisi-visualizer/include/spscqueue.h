@@ -0,0 +1,84 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+//! Bounded lock-free queue for one producer and one consumer thread
+/*!
+ * push() must only be called from the producer thread, pop() only from
+ * the consumer thread. Neither blocks nor allocates: a full queue rejects
+ * the element, an empty one returns false. The capacity is rounded up to
+ * a power of two.
+ *
+ * T is copied in and out, so it should be small and trivially copyable.
+ */
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(std::size_t capacity)
+        : head_(0),
+          tail_(0)
+    {
+        std::size_t size = 2;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+        mask_ = size - 1;
+        slots_.resize(size);
+    }
+
+    //! Producer: append value, returns false if the queue is full
+    bool push(const T& value)
+    {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) > mask_)
+        {
+            return false;
+        }
+        slots_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! Consumer: take the oldest value, returns false if the queue is empty
+    bool pop(T& value)
+    {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        value = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! Number of queued values, only a hint while the other side runs
+    std::size_t size() const
+    {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    std::size_t capacity() const
+    {
+        return mask_ + 1;
+    }
+
+private:
+    SpscQueue(const SpscQueue&);
+    SpscQueue& operator=(const SpscQueue&);
+
+    std::vector<T> slots_;
+    std::size_t mask_;
+
+    // Producer and consumer indices on separate cache lines
+    std::atomic<std::size_t> head_;
+    char padding_[64];
+    std::atomic<std::size_t> tail_;
+};
+
+#endif // SPSCQUEUE_H
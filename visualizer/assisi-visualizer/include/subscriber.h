@@ -1,11 +1,27 @@
 #ifndef SUBSCRIBER_H
 #define SUBSCRIBER_H
 
+#include "animator.h"
+#include "densitymap.h"
+#include "entitystore.h"
+
 #include <QObject>
 #include <QRectF>
-#include <nzmqt/nzmqt.hpp>
+#include <QThread>
 
 #include <map>
+#include <string>
+#include <vector>
+
+class Ingestor;
+struct StateDelta;
+
+//! Data on display
+/*!
+ * Messages are received and parsed by an Ingestor in its own thread.
+ * The resulting state changes are applied by drain(), on the GUI
+ * thread, once per frame.
+ */
 class Subscriber : public QObject
 {
     Q_OBJECT
@@ -13,6 +29,36 @@ public:
     explicit Subscriber(const QList<QString>& addresses,
                         const QList<QString>& topics,
                         QObject *parent = 0);
+    ~Subscriber();
+
+    //! Apply the state changes received since the last call
+    /*!
+     * At most drainLimit() changes are applied per call, the rest are left
+     * for the next frame, and dataChanged() is emitted again.
+     * Returns true if anything on display may have changed.
+     */
+    bool drain();
+
+    //! Set the maximal number of state changes applied by one drain()
+    void setDrainLimit(int deltas);
+    int drainLimit() const;
+
+    //! Extrapolate agent positions up to max_age ns, see EntityStore::setPrediction()
+    void setPrediction(qint64 max_age);
+
+    //! See Ingestor::setSpinBudget()
+    void setSpinBudget(int usec);
+
+    //! See Ingestor::receivedMessages()
+    quint64 receivedMessages() const;
+    //! See Ingestor::coalescedMessages()
+    quint64 coalescedMessages() const;
+    //! See Ingestor::malformedMessages()
+    quint64 malformedMessages() const;
+    //! See Ingestor::droppedDeltas()
+    quint64 droppedDeltas() const;
+    //! See Ingestor::lostBatches()
+    quint64 lostBatches() const;
 
     //! Struct for hodling CASU data
     struct CasuData
@@ -24,6 +70,8 @@ public:
         double temp_ref;
         std::vector<double> ir_ranges;
         std::vector<double> ir_thresholds;
+        //! Set when any displayed value changes, reset by the renderer
+        bool dirty;
     };
     typedef std::map<std::string,CasuData> CasuMap;
 
@@ -33,68 +81,66 @@ public:
      */
     CasuMap casu_data;
 
-    //! Struct for holding fish data
-    struct FishData
-    {
-        //! Initialize all values to reasonable defaults
-        FishData();
-
-        //! Append position
-        /*!
-         * Automatically updates the circular buffer of positions
-         * and computes the motion direction.
-         *
-         * w, h are width and height values for rendering the obect.
-         * defaults are for fish.
-         */
-        void appendPos(double xk, double yk, double w = 100, double h = 30);
-
-        QList<double> x;
-        QList<double> y;
-        //! +1 is CCW, -1 is CW
-        double direction;
-        int buff_max;
-        // Rectangle for rendering the fish pose
-        QRectF pose;
-
-        double tank_scale_x;
-        double tank_scale_y;
-        int tank_offset_x;
-        int tank_offset_y;
-    };
-    typedef std::map<QString,FishData> FishMap;
+    //! Tracked fish and ribots
+    /*! Only the Subscriber is supposed to write!
+     */
+    EntityStore fish;
+    EntityStore ribots;
 
-    //! Stores fish data
-    /*! Everything is public, but
-        Only the subscriber is supposed to write!
+    //! Direction most fish swim in, +1 is CCW, -1 is CW
+    /*!
+     * Estimated from the tracked positions, the direction last sent by
+     * CATS is used while the fish are not moving.
      */
-    FishMap fish_data;
-    FishMap ribot_data;
+    int fishDirection() const;
+    //! Same as fishDirection(), for the ribots
+    int ribotDirection() const;
+
+    //! Where the fish have been, decayed by the renderer
+    DensityMap fish_density;
+
+    //! Clock and tweens of the message animations
+    Animator animator;
 
     struct CasuMsg
     {
-        CasuMsg(int kx0, int ky, int kw = 95, int kh = 95);
+        CasuMsg(Animator* kanimator, int kx0, int ky, int kw = 95, int kh = 95);
         void incoming(int m);
-        void update(void);
+        //! Sample the animation at time, in ns of the animator clock
+        void update(qint64 time);
+        Animator* animator;
         int count;
         double x0, x, y, w, h;
-        double dx, x_max;
+        //! Speed in px/s
+        double speed, x_max;
+        //! Tween moving the message
+        int tween;
         bool active;
         QRectF pose;
+        //! Area that needs repainting, reset by the renderer
+        QRectF damage;
     };
     CasuMsg msg_top;
     CasuMsg msg_bottom;
 
     struct CatsMsg
     {
-        CatsMsg(int kx0, int ky0, int kw = 160, int kh = 80);
-        void incoming(QString fish_dir, QString ribot_dir);
-        void update(void);
-        int dir_to_int(QString dir);
+        CatsMsg(Animator* kanimator, int kx0, int ky0, int kw = 160, int kh = 80);
+        //! Directions are +1 for CCW, -1 for CW
+        void incoming(int fish_dir, int ribot_dir);
+        //! Sample the animation at time, in ns of the animator clock
+        void update(qint64 time);
+        Animator* animator;
         int fish_direction;
         int ribot_direction;
         double x0, y0, x, y_top, y_bot, rot_fish, rot_ribot, w, h;
-        double dx, dy, drot, x_mid, x_min;
+        //! Speeds in px/s and deg/s
+        double speed_x, speed_y, speed_rot, x_mid, x_min;
+        //! Tweens: both containers to x_mid, then apart to x_min; icon spin
+        int approach;
+        int split_top;
+        int split_bot;
+        int spin;
         bool active;
         QRectF pose_top;
         QRectF pose_bot;
@@ -102,25 +148,28 @@ public:
         QRectF ribot_dir_bot;
         QRectF fish_dir_top;
         QRectF fish_dir_bot;
+        //! Area that needs repainting, reset by the renderer
+        QRectF damage;
     };
     CatsMsg msg_cats;
 
 signals:
-    void pingReceived(const QList<QByteArray>& message);
-
-public slots:
-    void messageReceived(const QList<QByteArray>& message);
+    //! New data is waiting to be drained
+    void dataChanged();
 
 private:
-
-    // ZMQ connection details
-    nzmqt::ZMQContext* context_;
-
-    QList<QString> addresses_;
-    QList<QString> topics_;
-
-    nzmqt::ZMQSocket* socket_;
-
+    //! Returns true if the delta changed anything on display
+    bool apply(const StateDelta& delta);
+
+    // Receiving and parsing
+    QThread ingest_thread_;
+    Ingestor* ingestor_;
+    // CASUs by the index used in deltas, resolved once instead of
+    // looked up by name for every delta
+    std::vector<CasuData*> casus_;
+    std::vector<CasuMsg*> casu_msgs_;
+
+    int drain_limit_;
 };
 
 #endif // SUBSCRIBER_H
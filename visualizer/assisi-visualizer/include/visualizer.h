@@ -1,6 +1,11 @@
 #ifndef VISUALIZER_H
 #define VISUALIZER_H
 
+#include "scene.h"
+
+#include <QImage>
+#include <QRegion>
+#include <QThread>
 #include <QWidget>
 
 namespace Ui {
@@ -8,7 +13,8 @@ class VAssisi;
 }
 
 class Subscriber;
-class QSvgRenderer;
+class FrameRenderer;
+class FrameScheduler;
 
 class Visualizer : public QWidget
 {
@@ -17,52 +23,93 @@ class Visualizer : public QWidget
 public:
     explicit Visualizer(const QString& config_path, QWidget *parent = 0);
     ~Visualizer();
-    QColor tempToColor(double temp);
-    double tempToAngle(double temp);
+
+    //! Replace the tracked fish by synthetic ones
+    /*!
+     * The agents swim around the tank, and frame render times are
+     * reported periodically. Used to check that frame times do not
+     * grow with the number of agents.
+     */
+    void startStressTest(int agents);
+
+    //! Set the maximal frame rate
+    void setMaxFps(double fps);
+
+    //! Extrapolate agent positions up to msec milliseconds past the last update, 0 disables
+    void setPrediction(int msec);
+
+    //! Busy wait up to usec microseconds for further messages before sleeping
+    void setReceiveSpin(int usec);
+
+signals:
+    //! Ask the render thread for a new frame
+    void renderRequested(const SceneState& state, const QRegion& damage,
+                         const QSize& size, qreal dpr);
+
+protected slots:
+    //! Advance animations by dt seconds and repaint only what changed
+    void updateScene(double dt);
+
+    //! Show a frame finished by the render thread
+    void frameReady(const QImage& frame, const QRegion& damage, qint64 render_time);
+
+    //! Show achieved frame rate, dropped frames, receive counters and shoal metrics in the window title
+    void showStatistics(double fps, qint64 dropped_frames);
 
 protected:
+    //! Mark an area, given in scene coordinates, for repainting
+    void addDamage(const QRectF& area);
+
+    //! Copy everything that is displayed
+    SceneState snapshot() const;
+
+    //! Hand the collected damage over to the render thread
+    /*!
+     * Only one frame is in flight at a time, damage collected meanwhile
+     * is rendered with the next frame handed out by the scheduler.
+     */
+    void requestFrame();
+
     virtual void paintEvent(QPaintEvent *event);
-    void drawRotatedSvg(QPainter& painter,
-                        QRectF area,
-                        double angle,
-                        const QString& resource_name);
+    virtual void resizeEvent(QResizeEvent *event);
+    //! Show what is known about the fish or ribot under the cursor
+    virtual void mousePressEvent(QMouseEvent *event);
 
 private:
     Ui::VAssisi *ui;
 
     Subscriber* sub_;
 
-    QSvgRenderer* svg_;
+    // Placement of the scene items
+    SceneLayout layout_;
 
-    // Fish tank dimensions
-    QRect fish_tank_outer_;
-    QRect fish_tank_inner_;
+    // Rendering
+    QThread render_thread_;
+    FrameRenderer* renderer_;
+    //! Last finished frame
+    QImage frame_;
+    //! A frame is being rendered
+    bool frame_in_flight_;
 
-    // Bee arena dimensions
-    QRect bee_arena_;
-    QRect casu_top_;
-    QRect casu_bottom_;
-    QRect heating_area_top_;
-    QRect heating_area_bottom_;
+    // Decides when frames are produced
+    FrameScheduler* scheduler_;
 
-    // Communication arrow dimensions
-    QRect double_arrow_;
-    QRect top_arrow_;
-    QRect bottom_arrow_;
+    // Widget area to be repainted on the next frame
+    QRegion damage_;
 
-    // Scene dimensions
-    qreal default_scene_width_;
-    qreal default_scene_height_;
+    // Swimming directions used for the agent sprites on screen
+    int painted_fish_direction_;
+    int painted_ribot_direction_;
 
-    // Sample time for scene refreshing
-    double td_;
+    // Stress test
+    int stress_agents_;
+    double stress_time_;
 
-};
+    // Render time statistics, in nanoseconds
+    int stats_frames_;
+    qint64 stats_render_time_;
+    qint64 stats_render_time_max_;
 
-template <typename T>
-T clip(T x, T lower, T upper)
-{
-    return std::max(lower, std::min(x, upper));
-}
+};
 
 #endif // VISUALIZER_H
@@ -0,0 +1,69 @@
+#ifndef WIRESCANNER_H
+#define WIRESCANNER_H
+
+#include <cstddef>
+
+namespace google
+{
+namespace protobuf
+{
+class Descriptor;
+}
+}
+
+//! Reads single fields from protobuf wire format, without parsing messages
+/*!
+ * The sensor messages are small arrays of which only a few values are
+ * displayed. The scanner walks the encoded fields, skips those it is not
+ * asked for, and decodes the values of the requested field in place, packed
+ * or not. It does not allocate.
+ *
+ * Field numbers and types are resolved from the message descriptors, so a
+ * schema that does not fit (e.g. an integer field) is detected once, and the
+ * caller can fall back to a full parse.
+ */
+class WireScanner
+{
+public:
+    //! A double or float field of a message type
+    struct Field
+    {
+        //! -1 if the field cannot be scanned
+        int number;
+        bool is_float;
+        bool is_repeated;
+
+        bool isValid() const { return number > 0; }
+    };
+
+    //! Returns the field called name of the message type
+    /*!
+     * The field is invalid if it does not exist, or is not a double or
+     * float field.
+     */
+    static Field resolve(const google::protobuf::Descriptor* type, const char* name);
+
+    //! Scan the payload in data, which has to outlive the scanner
+    WireScanner(const char* data, std::size_t size);
+
+    //! Copy the values of a repeated field
+    /*!
+     * At most max values are copied. Returns the number of values of the
+     * field in the payload, which may be larger than max, or -1 if the
+     * payload is malformed or does not match the field's type.
+     */
+    int values(const Field& field, double* values, int max) const;
+
+    //! Read a singular field, the last occurrence wins
+    /*!
+     * Returns false if the field is missing, the payload is malformed, or
+     * does not match the field's type.
+     */
+    bool value(const Field& field, double* value) const;
+
+private:
+    const unsigned char* begin_;
+    const unsigned char* end_;
+};
+
+#endif // WIRESCANNER_H
@@ -0,0 +1,117 @@
+#include "animator.h"
+
+#include <cmath>
+
+Keyframe::Keyframe(const QPointF& kpos, double krotation, double kopacity)
+    : pos(kpos),
+      rotation(krotation),
+      opacity(kopacity)
+{
+
+}
+
+Animator::Animator()
+{
+    clock_.start();
+}
+
+qint64 Animator::now() const
+{
+    return clock_.nsecsElapsed();
+}
+
+int Animator::start(const Keyframe& from, const Keyframe& to,
+                    double duration, double delay,
+                    Easing easing)
+{
+    int id;
+    if (free_.isEmpty())
+    {
+        tweens_.append(Tween());
+        id = tweens_.size() - 1;
+    }
+    else
+    {
+        id = free_.last();
+        free_.removeLast();
+    }
+
+    Tween& tween = tweens_[id];
+    tween.from = from;
+    tween.to = to;
+    tween.start = now() + static_cast<qint64>(delay*1e9);
+    tween.duration = static_cast<qint64>(duration*1e9);
+    tween.easing = easing;
+    tween.used = true;
+    return id;
+}
+
+void Animator::release(int id)
+{
+    if (id >= 0 && id < tweens_.size() && tweens_.at(id).used)
+    {
+        tweens_[id].used = false;
+        free_.append(id);
+    }
+}
+
+Keyframe Animator::sample(int id, qint64 time) const
+{
+    if (id < 0 || id >= tweens_.size())
+    {
+        return Keyframe();
+    }
+
+    const Tween& tween = tweens_.at(id);
+    if (time <= tween.start)
+    {
+        return tween.from;
+    }
+    if (time >= tween.start + tween.duration)
+    {
+        return tween.to;
+    }
+
+    double k = ease(tween.easing, double(time - tween.start)/tween.duration);
+    return Keyframe(tween.from.pos + k*(tween.to.pos - tween.from.pos),
+                    tween.from.rotation + k*(tween.to.rotation - tween.from.rotation),
+                    tween.from.opacity + k*(tween.to.opacity - tween.from.opacity));
+}
+
+bool Animator::finished(int id, qint64 time) const
+{
+    if (id < 0 || id >= tweens_.size())
+    {
+        return true;
+    }
+    const Tween& tween = tweens_.at(id);
+    return time >= tween.start + tween.duration;
+}
+
+int Animator::size() const
+{
+    return tweens_.size() - free_.size();
+}
+
+double Animator::ease(Easing easing, double progress)
+{
+    const double pi = 3.14159265358979323846;
+    switch (easing)
+    {
+    case Linear:
+        return progress;
+    case InQuad:
+        return progress*progress;
+    case OutQuad:
+        return progress*(2.0 - progress);
+    case InOutQuad:
+        if (progress < 0.5)
+        {
+            return 2.0*progress*progress;
+        }
+        return -1.0 + (4.0 - 2.0*progress)*progress;
+    case InOutSine:
+        return 0.5*(1.0 - std::cos(pi*progress));
+    }
+    return progress;
+}
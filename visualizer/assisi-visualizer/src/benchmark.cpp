@@ -0,0 +1,95 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+//! Written, but never read
+volatile double sink = 0.0;
+
+}
+
+Benchmark::~Benchmark()
+{
+
+}
+
+void Benchmark::keep(double value)
+{
+    sink = value;
+}
+
+Benchmark::Samples::Samples()
+    : sorted_(true)
+{
+
+}
+
+void Benchmark::Samples::reserve(int count)
+{
+    durations_.reserve(count);
+}
+
+void Benchmark::Samples::start()
+{
+    timer_.start();
+}
+
+qint64 Benchmark::Samples::elapsed() const
+{
+    return timer_.nsecsElapsed();
+}
+
+qint64 Benchmark::Samples::stop()
+{
+    qint64 duration = timer_.nsecsElapsed();
+    add(duration);
+    return duration;
+}
+
+void Benchmark::Samples::add(qint64 duration)
+{
+    durations_.push_back(duration);
+    sorted_ = false;
+}
+
+int Benchmark::Samples::size() const
+{
+    return static_cast<int>(durations_.size());
+}
+
+double Benchmark::Samples::mean() const
+{
+    if (durations_.empty())
+    {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (size_t i = 0; i < durations_.size(); i++)
+    {
+        sum += durations_[i];
+    }
+    return sum/durations_.size();
+}
+
+qint64 Benchmark::Samples::percentile(double p) const
+{
+    if (durations_.empty())
+    {
+        return 0;
+    }
+    if (!sorted_)
+    {
+        std::sort(durations_.begin(), durations_.end());
+        sorted_ = true;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(p*durations_.size()));
+    return durations_[std::min(std::max<size_t>(rank, 1), durations_.size()) - 1];
+}
+
+qint64 Benchmark::Samples::max() const
+{
+    return percentile(1.0);
+}
@@ -0,0 +1,251 @@
+#include "bytespan.h"
+
+#include <QByteArray>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace
+{
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+//! Exactly representable powers of ten
+const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+//! Slow path for numbers the fast path cannot round exactly
+/*!
+ * QByteArray always reads '.' as the decimal point, strtod would follow
+ * the locale QApplication sets. QByteArray copies raw data to terminate it
+ * before parsing, so the span is copied into a buffer of the thread
+ * instead, which keeps its capacity between numbers.
+ */
+bool parseSlowly(const char* data, std::size_t size, double* value)
+{
+    if (size == 0)
+    {
+        return false;
+    }
+    static thread_local QByteArray buffer;
+    buffer.reserve(std::max(buffer.capacity(), static_cast<int>(size)));
+    buffer.resize(static_cast<int>(size));
+    std::memcpy(buffer.data(), data, size);
+    bool ok = false;
+    double result = buffer.toDouble(&ok);
+    if (!ok)
+    {
+        return false;
+    }
+    *value = result;
+    return true;
+}
+
+}
+
+ByteSpan::ByteSpan()
+    : data_(NULL),
+      size_(0)
+{
+
+}
+
+ByteSpan::ByteSpan(const char* data, std::size_t size)
+    : data_(data),
+      size_(size)
+{
+
+}
+
+ByteSpan ByteSpan::trimmed() const
+{
+    const char* begin = data_;
+    const char* end = data_ + size_;
+    while (begin < end && isSpace(*begin)) begin++;
+    while (end > begin && isSpace(end[-1])) end--;
+    return ByteSpan(begin, end - begin);
+}
+
+bool ByteSpan::equals(const char* str) const
+{
+    return std::strlen(str) == size_ && std::memcmp(data_, str, size_) == 0;
+}
+
+bool ByteSpan::toDouble(double* value) const
+{
+    ByteSpan span = trimmed();
+    const char* pos = span.data_;
+    const char* end = pos + span.size_;
+
+    bool negative = false;
+    if (pos < end && (*pos == '-' || *pos == '+'))
+    {
+        negative = (*pos == '-');
+        pos++;
+    }
+
+    // Up to 19 significant digits fit the mantissa
+    unsigned long long mantissa = 0;
+    int significant = 0;
+    int exponent = 0;
+    bool any_digit = false;
+    bool truncated = false;
+    for (; pos < end && isDigit(*pos); pos++)
+    {
+        any_digit = true;
+        if (significant < 19)
+        {
+            mantissa = mantissa*10 + (*pos - '0');
+            significant += (mantissa != 0);
+        }
+        else
+        {
+            truncated = truncated || *pos != '0';
+            exponent++;
+        }
+    }
+    if (pos < end && *pos == '.')
+    {
+        for (pos++; pos < end && isDigit(*pos); pos++)
+        {
+            any_digit = true;
+            if (significant < 19)
+            {
+                mantissa = mantissa*10 + (*pos - '0');
+                significant += (mantissa != 0);
+                exponent--;
+            }
+            else
+            {
+                truncated = truncated || *pos != '0';
+            }
+        }
+    }
+    if (any_digit && pos < end && (*pos == 'e' || *pos == 'E'))
+    {
+        pos++;
+        bool negative_exponent = false;
+        if (pos < end && (*pos == '-' || *pos == '+'))
+        {
+            negative_exponent = (*pos == '-');
+            pos++;
+        }
+        if (pos == end || !isDigit(*pos))
+        {
+            return false;
+        }
+        int exp = 0;
+        for (; pos < end && isDigit(*pos); pos++)
+        {
+            if (exp < 100000)
+            {
+                exp = exp*10 + (*pos - '0');
+            }
+        }
+        exponent += negative_exponent ? -exp : exp;
+    }
+
+    if (!any_digit || pos != end)
+    {
+        // Not a plain decimal number, e.g. "inf" or hexadecimal
+        return parseSlowly(span.data_, span.size_, value);
+    }
+
+    if (mantissa == 0)
+    {
+        *value = negative ? -0.0 : 0.0;
+        return true;
+    }
+    // Both the mantissa and the power of ten are exact, so is the result
+    if (!truncated && mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22)
+    {
+        double result = static_cast<double>(mantissa);
+        result = exponent < 0 ? result/powers_of_ten[-exponent] : result*powers_of_ten[exponent];
+        *value = negative ? -result : result;
+        return true;
+    }
+    return parseSlowly(span.data_, span.size_, value);
+}
+
+bool ByteSpan::toInt(int* value) const
+{
+    ByteSpan span = trimmed();
+    const char* pos = span.data_;
+    const char* end = pos + span.size_;
+
+    bool negative = false;
+    if (pos < end && (*pos == '-' || *pos == '+'))
+    {
+        negative = (*pos == '-');
+        pos++;
+    }
+    if (pos == end)
+    {
+        return false;
+    }
+
+    long long result = 0;
+    for (; pos < end; pos++)
+    {
+        if (!isDigit(*pos))
+        {
+            return false;
+        }
+        result = result*10 + (*pos - '0');
+        if (result > static_cast<long long>(INT_MAX) + 1)
+        {
+            return false;
+        }
+    }
+    result = negative ? -result : result;
+    if (result > INT_MAX)
+    {
+        return false;
+    }
+    *value = static_cast<int>(result);
+    return true;
+}
+
+SpanTokenizer::SpanTokenizer(const ByteSpan& span, char separator)
+    : pos_(span.data()),
+      end_(span.data() + span.size()),
+      separator_(separator),
+      done_(false)
+{
+
+}
+
+bool SpanTokenizer::next(ByteSpan* token)
+{
+    if (done_)
+    {
+        return false;
+    }
+    const char* separator = static_cast<const char*>(std::memchr(pos_, separator_, end_ - pos_));
+    if (separator == NULL)
+    {
+        *token = ByteSpan(pos_, end_ - pos_);
+        pos_ = end_;
+        done_ = true;
+        return true;
+    }
+    *token = ByteSpan(pos_, separator - pos_);
+    pos_ = separator + 1;
+    return true;
+}
+
+bool SpanTokenizer::atEnd() const
+{
+    return done_;
+}
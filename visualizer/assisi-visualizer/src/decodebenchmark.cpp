@@ -0,0 +1,309 @@
+#include "decodebenchmark.h"
+#include "allocationcounter.h"
+#include "ingestor.h"
+#include "positionbatch.h"
+#include "wirescanner.h"
+#include "dev_msgs.pb.h"
+
+#include <QtEndian>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace nzmqt;
+
+namespace
+{
+
+void append(ZMQMultipartMessage& message, const char* str)
+{
+    message.append(str, std::strlen(str));
+}
+
+void append(ZMQMultipartMessage& message, const std::string& str)
+{
+    message.append(str.data(), str.size());
+}
+
+//! Parse a payload n times into fresh messages, returns ns per payload
+template <typename Message>
+double timeParseFromString(const std::string& payload, int n)
+{
+    Benchmark::Samples time;
+    time.start();
+    for (int i = 0; i < n; i++)
+    {
+        Message message;
+        message.ParseFromString(payload);
+    }
+    return double(time.stop())/n;
+}
+
+//! Parse a payload n times into the same message, returns ns per payload
+template <typename Message>
+double timeParseReused(const std::string& payload, int n)
+{
+    Message message;
+    Benchmark::Samples time;
+    time.start();
+    for (int i = 0; i < n; i++)
+    {
+        message.ParseFromArray(payload.data(), static_cast<int>(payload.size()));
+    }
+    return double(time.stop())/n;
+}
+
+//! Scan a field of a payload n times, returns ns per payload
+double timeScan(const std::string& payload, const WireScanner::Field& field, int n)
+{
+    double values[8];
+    double sum = 0.0;
+    Benchmark::Samples time;
+    time.start();
+    for (int i = 0; i < n; i++)
+    {
+        WireScanner(payload.data(), payload.size()).values(field, values, 8);
+        sum += values[0];
+    }
+    qint64 elapsed = time.stop();
+    Benchmark::keep(sum);
+    return double(elapsed)/n;
+}
+
+//! Advance the sequence number of a batch message, as the tracker does every tick
+/*!
+ * Repeated batches are ignored. The benchmark owns the message, so its
+ * frame is written in place.
+ */
+void nextBatch(ZMQMultipartMessage& message)
+{
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(const_cast<char*>(message.frame(1).data));
+    qToLittleEndian<quint32>(qFromLittleEndian<quint32>(bytes) + 1, bytes);
+}
+
+//! Pop everything the ingestor queued
+int drain(Ingestor& ingestor)
+{
+    int deltas = 0;
+    StateDelta delta;
+    while (ingestor.queue().pop(delta))
+    {
+        deltas++;
+    }
+    return deltas;
+}
+
+}
+
+DecodeBenchmark::DecodeBenchmark(int messages)
+    : messages_(messages)
+{
+
+}
+
+int DecodeBenchmark::run()
+{
+    QList<QString> casu_names;
+    casu_names.append("casu-001");
+    casu_names.append("casu-002");
+    Ingestor ingestor(QList<QString>(), QList<QString>(), casu_names);
+
+    // One message per type, as published by the CASUs, CATS and the tracker
+    const int num_types = 9;
+    const char* names[num_types] = {"Temp", "IR", "Peltier", "cats", "FishPosition", "CASUPosition", "CommEth",
+                                    "50 fish batch", "17 digits"};
+    // Deltas each message has to produce, whatever the locale
+    const int expected_deltas[num_types] = {1, 1, 1, 1, 1, 1, 1, 50, 1};
+    const int batch_type = 7;
+    ZMQMultipartMessage messages[num_types];
+
+    AssisiMsg::TemperatureArray temps;
+    for (int i = 0; i < 8; i++)
+    {
+        temps.add_temp(28.0 + i*0.5);
+    }
+    append(messages[0], "casu-001");
+    append(messages[0], "Temp");
+    append(messages[0], "Temperatures");
+    append(messages[0], temps.SerializeAsString());
+
+    AssisiMsg::RangeArray ranges;
+    for (int i = 0; i < 6; i++)
+    {
+        ranges.add_raw_value(11000.0 + i*1500.0);
+    }
+    append(messages[1], "casu-002");
+    append(messages[1], "IR");
+    append(messages[1], "Ranges");
+    append(messages[1], ranges.SerializeAsString());
+
+    AssisiMsg::Temperature setpoint;
+    setpoint.set_temp(36.0);
+    append(messages[2], "casu-001");
+    append(messages[2], "Peltier");
+    append(messages[2], "temp");
+    append(messages[2], setpoint.SerializeAsString());
+
+    append(messages[3], "cats");
+    append(messages[3], "CommEth");
+    append(messages[3], "casu-002");
+    append(messages[3], "0.5");
+
+    append(messages[4], "FishPosition");
+    append(messages[4], "3");
+    append(messages[4], "251.75");
+    append(messages[4], "103.5");
+
+    append(messages[5], "CASUPosition");
+    append(messages[5], "0");
+    append(messages[5], "120.25");
+    append(messages[5], "377.0");
+
+    append(messages[6], "casu-001");
+    append(messages[6], "CommEth");
+    append(messages[6], "cats");
+    append(messages[6], "fish:CW,fishCASU:CCW");
+
+    // A tracker tick of a 50 fish shoal
+    QVector<PositionBatch::Record> records(50);
+    for (int i = 0; i < records.size(); i++)
+    {
+        records[i].id = i;
+        records[i].x = 10.0f*(i % 10);
+        records[i].y = 40.0f*(i/10);
+        records[i].heading = 0.1f*i;
+    }
+    append(messages[7], "FishPosition");
+    QByteArray batch = PositionBatch::write(0, 0, records);
+    messages[7].append(batch.constData(), batch.size());
+
+    // Coordinates as printed by Python's repr(), too long for the fast path
+    append(messages[8], "FishPosition");
+    append(messages[8], "4");
+    append(messages[8], "123.45678901234568");
+    append(messages[8], "0.30000000000000004");
+
+    std::printf("Decoding %d messages per type\n", messages_);
+    if (!AllocationCounter::enabled())
+    {
+        std::printf("Allocations are not counted, build with CONFIG+=count_allocations\n");
+    }
+
+    // Payloads are scanned, or parsed in place or into reused messages,
+    // so no message type may allocate once warmed up
+    const int num_sensor_types = 3;
+    bool allocates = false;
+    bool rejected = false;
+
+    for (int t = 0; t < num_types; t++)
+    {
+        // Warm up, so only steady state allocations are counted
+        for (int i = 0; i < 1000; i++)
+        {
+            if (t == batch_type)
+            {
+                nextBatch(messages[t]);
+            }
+            ingestor.handleMessage(NULL, messages[t]);
+            ingestor.flush();
+            drain(ingestor);
+        }
+
+        qint64 deltas = 0;
+        quint64 allocations = AllocationCounter::count();
+        Samples time;
+        time.start();
+        for (int i = 0; i < messages_; i++)
+        {
+            if (t == batch_type)
+            {
+                nextBatch(messages[t]);
+            }
+            ingestor.handleMessage(NULL, messages[t]);
+            ingestor.flush();
+            deltas += drain(ingestor);
+        }
+        qint64 elapsed = time.stop();
+        allocations = AllocationCounter::count() - allocations;
+        if (allocations > 0)
+        {
+            allocates = true;
+        }
+        if (deltas < qint64(expected_deltas[t])*messages_)
+        {
+            rejected = true;
+        }
+
+        std::printf("%-13s %9.1f ns/msg", names[t], double(elapsed)/messages_);
+        if (AllocationCounter::enabled())
+        {
+            std::printf(" %7.2f allocations/msg", double(allocations)/messages_);
+        }
+        std::printf(" %7.2f deltas/msg\n", double(deltas)/messages_);
+    }
+
+    // IR arriving in bursts of three, each burst ends a batch
+    int deltas = 0;
+    quint64 coalesced = ingestor.coalescedMessages();
+    quint64 allocations = AllocationCounter::count();
+    Samples time;
+    time.start();
+    for (int i = 0; i < messages_; i++)
+    {
+        ingestor.handleMessage(NULL, messages[1]);
+        if (i % 3 == 2)
+        {
+            ingestor.flush();
+            deltas += drain(ingestor);
+        }
+    }
+    ingestor.flush();
+    deltas += drain(ingestor);
+    qint64 elapsed = time.stop();
+    allocations = AllocationCounter::count() - allocations;
+    if (allocations > 0)
+    {
+        allocates = true;
+    }
+    coalesced = ingestor.coalescedMessages() - coalesced;
+    std::printf("%-13s %9.1f ns/msg %7.2f deltas/msg %7.2f coalesced/msg\n", "IR conflated",
+                double(elapsed)/messages_, double(deltas)/messages_, double(coalesced)/messages_);
+
+    // The sensor payloads alone, parsed in full or scanned
+    std::string payloads[num_sensor_types] = {
+        temps.SerializeAsString(), ranges.SerializeAsString(), setpoint.SerializeAsString()
+    };
+    double parsed[num_sensor_types] = {
+        timeParseFromString<AssisiMsg::TemperatureArray>(payloads[0], messages_),
+        timeParseFromString<AssisiMsg::RangeArray>(payloads[1], messages_),
+        timeParseFromString<AssisiMsg::Temperature>(payloads[2], messages_)
+    };
+    double reused[num_sensor_types] = {
+        timeParseReused<AssisiMsg::TemperatureArray>(payloads[0], messages_),
+        timeParseReused<AssisiMsg::RangeArray>(payloads[1], messages_),
+        timeParseReused<AssisiMsg::Temperature>(payloads[2], messages_)
+    };
+    double scanned[num_sensor_types] = {
+        timeScan(payloads[0], WireScanner::resolve(AssisiMsg::TemperatureArray::descriptor(), "temp"), messages_),
+        timeScan(payloads[1], WireScanner::resolve(AssisiMsg::RangeArray::descriptor(), "raw_value"), messages_),
+        timeScan(payloads[2], WireScanner::resolve(AssisiMsg::Temperature::descriptor(), "temp"), messages_)
+    };
+    std::printf("\nPayload        ParseFromString  ParseFromArray reused     WireScanner\n");
+    for (int t = 0; t < num_sensor_types; t++)
+    {
+        std::printf("%-13s %12.1f ns %18.1f ns %12.1f ns\n", names[t], parsed[t], reused[t], scanned[t]);
+    }
+
+    if (rejected)
+    {
+        std::printf("Messages were rejected\n");
+        return 1;
+    }
+    if (allocates)
+    {
+        std::printf("Messages allocate in steady state\n");
+        return 1;
+    }
+    return 0;
+}
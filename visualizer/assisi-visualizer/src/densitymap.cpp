@@ -0,0 +1,174 @@
+#include "densitymap.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+DensityMap::DensityMap(const QRectF& area, double cell_size)
+    : area_(area),
+      cell_size_(cell_size),
+      cols_(std::max(1, static_cast<int>(std::ceil(area.width()/cell_size)))),
+      rows_(std::max(1, static_cast<int>(std::ceil(area.height()/cell_size)))),
+      cells_(cols_*rows_, 0.0f),
+      max_(0.0f),
+      changed_(false),
+      last_update_(-1),
+      half_life_(10.0),
+      saturation_(30.0),
+      image_(cols_, rows_, QImage::Format_ARGB32_Premultiplied)
+{
+    image_.fill(Qt::transparent);
+
+    // Transparent, through blue and yellow, to red
+    const int num_stops = 4;
+    const double stops[num_stops][5] = {
+        {0.0,    0,   0, 255,   0},
+        {0.3,    0,   0, 255,  90},
+        {0.65, 255, 220,   0, 130},
+        {1.0,  255,   0,   0, 170}
+    };
+    for (int i = 0; i < 256; i++)
+    {
+        double v = i/255.0;
+        int s = 1;
+        while (s < num_stops - 1 && stops[s][0] < v)
+        {
+            s++;
+        }
+        double k = (v - stops[s-1][0])/(stops[s][0] - stops[s-1][0]);
+        int c[4];
+        for (int j = 0; j < 4; j++)
+        {
+            c[j] = static_cast<int>(stops[s-1][j+1] + k*(stops[s][j+1] - stops[s-1][j+1]) + 0.5);
+        }
+        lut_[i] = qPremultiply(qRgba(c[0], c[1], c[2], c[3]));
+    }
+}
+
+void DensityMap::setHalfLife(double seconds)
+{
+    half_life_ = seconds;
+}
+
+void DensityMap::setSaturation(double weight)
+{
+    saturation_ = weight;
+    changed_ = true;
+}
+
+void DensityMap::splat(const QPointF& pos, double weight)
+{
+    // Bilinear splat onto the four cells around pos
+    double gx = (pos.x() - area_.left())/cell_size_ - 0.5;
+    double gy = (pos.y() - area_.top())/cell_size_ - 0.5;
+    int x0 = static_cast<int>(std::floor(gx));
+    int y0 = static_cast<int>(std::floor(gy));
+    double fx = gx - x0;
+    double fy = gy - y0;
+    if (x0 < -1 || y0 < -1 || x0 >= cols_ || y0 >= rows_)
+    {
+        return;
+    }
+
+    const double w[4] = {(1-fx)*(1-fy)*weight, fx*(1-fy)*weight,
+                         (1-fx)*fy*weight, fx*fy*weight};
+    for (int i = 0; i < 4; i++)
+    {
+        int x = x0 + (i & 1);
+        int y = y0 + (i >> 1);
+        if (x < 0 || y < 0 || x >= cols_ || y >= rows_)
+        {
+            continue;
+        }
+        float& cell = cells_[y*cols_ + x];
+        cell += static_cast<float>(w[i]);
+        max_ = std::max(max_, cell);
+    }
+    changed_ = true;
+}
+
+bool DensityMap::update(qint64 time)
+{
+    double dt = last_update_ < 0 ? 0.0 : (time - last_update_)/1e9;
+    last_update_ = time;
+    if (max_ == 0.0f && !changed_)
+    {
+        // Empty, nothing to decay or to show
+        return false;
+    }
+
+    if (dt > 0.0)
+    {
+        decay(static_cast<float>(std::exp2(-dt/half_life_)));
+        // Below the first colour step the map is empty, also keeps
+        // the cells from decaying into slow denormals
+        if (max_*255.0/saturation_ < 0.5)
+        {
+            std::fill(cells_.begin(), cells_.end(), 0.0f);
+            max_ = 0.0f;
+        }
+    }
+    colorize();
+    changed_ = false;
+    return true;
+}
+
+bool DensityMap::active() const
+{
+    return max_ > 0.0f;
+}
+
+const QRectF& DensityMap::area() const
+{
+    return area_;
+}
+
+const QImage& DensityMap::image() const
+{
+    return image_;
+}
+
+void DensityMap::decay(float factor)
+{
+    float* cells = cells_.data();
+    int n = static_cast<int>(cells_.size());
+    int i = 0;
+    float max = 0.0f;
+#ifdef __SSE__
+    __m128 k = _mm_set1_ps(factor);
+    __m128 m = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(cells + i), k);
+        _mm_storeu_ps(cells + i, v);
+        m = _mm_max_ps(m, v);
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, m);
+    max = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#endif
+    for (; i < n; i++)
+    {
+        cells[i] *= factor;
+        max = std::max(max, cells[i]);
+    }
+    max_ = max;
+}
+
+void DensityMap::colorize()
+{
+    // image_ may be shared with a frame being rendered, scanLine() detaches
+    float scale = static_cast<float>(255.0/saturation_);
+    for (int y = 0; y < rows_; y++)
+    {
+        const float* cells = cells_.data() + y*cols_;
+        QRgb* line = reinterpret_cast<QRgb*>(image_.scanLine(y));
+        for (int x = 0; x < cols_; x++)
+        {
+            line[x] = lut_[std::min(255, static_cast<int>(cells[x]*scale))];
+        }
+    }
+}
@@ -0,0 +1,519 @@
+#include "entitystore.h"
+#include "densitymap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+
+//! Time constant of the smoothed angular velocity, in seconds
+/*!
+ * Samples are weighted by the time they cover, so the smoothing does not
+ * depend on the tracker rate, or on how many updates were conflated.
+ */
+const double angular_time_constant = 0.5;
+
+//! Smoothed angular velocity, in radians per second, needed to change direction
+/*!
+ * An agent that circles the tank in 10 s turns at 0.63 rad/s. Agents
+ * slower than the threshold keep their direction, so that noise does not
+ * flip them.
+ */
+const double direction_threshold = 0.15;
+
+//! Distance from the centre, in scene coordinates, below which angles are too noisy
+const double min_radius = 20.0;
+
+//! Alpha-beta filter gains for position and velocity
+/*!
+ * Chosen for a critically damped response, beta = alpha^2/(2 - alpha).
+ */
+const double filter_alpha = 0.7;
+const double filter_beta = 0.377;
+
+//! Gap between positions, in seconds, after which the motion model restarts
+const double max_filter_gap = 1.0;
+
+//! Speed, in scene coordinates per second, below which an agent counts as resting
+const double min_speed = 5.0;
+
+}
+
+EntityStore::EntityStore(const QSizeF& sprite_size)
+    : sprite_size_(sprite_size),
+      scale_x_(1.0),
+      scale_y_(1.0),
+      offset_x_(0.0),
+      offset_y_(0.0),
+      density_(NULL),
+      center_x_(0.0),
+      center_y_(0.0),
+      max_prediction_age_(0),
+      grid_stale_(true),
+      ccw_count_(0),
+      cw_count_(0)
+{
+
+}
+
+void EntityStore::setTransform(double scale_x, double scale_y, double offset_x, double offset_y)
+{
+    scale_x_ = scale_x;
+    scale_y_ = scale_y;
+    offset_x_ = offset_x;
+    offset_y_ = offset_y;
+}
+
+void EntityStore::setDensityMap(DensityMap* density)
+{
+    density_ = density;
+}
+
+void EntityStore::setCenter(const QPointF& center)
+{
+    center_x_ = center.x();
+    center_y_ = center.y();
+}
+
+void EntityStore::setPrediction(qint64 max_age)
+{
+    max_prediction_age_ = std::max(Q_INT64_C(0), max_age);
+}
+
+qint64 EntityStore::prediction() const
+{
+    return max_prediction_age_;
+}
+
+void EntityStore::clear()
+{
+    slots_.clear();
+    ids_.clear();
+    x_.clear();
+    y_.clear();
+    sample_x_.clear();
+    sample_y_.clear();
+    sample_time_.clear();
+    filter_x_.clear();
+    filter_y_.clear();
+    velocity_x_.clear();
+    velocity_y_.clear();
+    update_time_.clear();
+    heading_.clear();
+    angular_velocity_.clear();
+    direction_.clear();
+    painted_x_.clear();
+    painted_y_.clear();
+    dirty_.clear();
+    history_.clear();
+    dirty_slots_.clear();
+    grid_stale_ = true;
+    ccw_count_ = 0;
+    cw_count_ = 0;
+    staged_slots_.clear();
+    staged_x_.clear();
+    staged_y_.clear();
+    staged_heading_.clear();
+    staged_time_.clear();
+    staged_angular_.clear();
+    staged_interval_.clear();
+}
+
+int EntityStore::slot(int id)
+{
+    QHash<int,int>::const_iterator it = slots_.constFind(id);
+    if (it != slots_.constEnd())
+    {
+        return it.value();
+    }
+
+    // First sight, the agent is shown once it has a position
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    int slot = static_cast<int>(ids_.size());
+    slots_.insert(id, slot);
+    ids_.push_back(id);
+    x_.push_back(nan);
+    y_.push_back(nan);
+    sample_x_.push_back(nan);
+    sample_y_.push_back(nan);
+    sample_time_.push_back(nan);
+    filter_x_.push_back(nan);
+    filter_y_.push_back(nan);
+    velocity_x_.push_back(0.0);
+    velocity_y_.push_back(0.0);
+    update_time_.push_back(0);
+    heading_.push_back(nan);
+    angular_velocity_.push_back(0.0);
+    direction_.push_back(0);
+    painted_x_.push_back(nan);
+    painted_y_.push_back(nan);
+    dirty_.push_back(false);
+    history_.push_back(History());
+    grid_stale_ = true;
+    return slot;
+}
+
+int EntityStore::find(int id) const
+{
+    return slots_.value(id, -1);
+}
+
+int EntityStore::size() const
+{
+    return static_cast<int>(ids_.size());
+}
+
+int EntityStore::id(int slot) const
+{
+    return ids_[slot];
+}
+
+void EntityStore::stage(int slot, double x, double y, double heading, double time)
+{
+    staged_slots_.push_back(slot);
+    staged_x_.push_back(x);
+    staged_y_.push_back(y);
+    staged_heading_.push_back(heading);
+    staged_time_.push_back(time);
+}
+
+void EntityStore::commit(qint64 time)
+{
+    const int count = static_cast<int>(staged_slots_.size());
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Tracker to scene coordinates, one pass over contiguous arrays
+    double* xs = &staged_x_[0];
+    double* ys = &staged_y_[0];
+    for (int i = 0; i < count; i++)
+    {
+        xs[i] = xs[i]*scale_x_ + offset_x_;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        ys[i] = ys[i]*scale_y_ + offset_y_;
+    }
+
+    // Angular velocity around the centre since the previous position. The
+    // scene y axis points down, so CCW on screen is a negative cross product
+    staged_angular_.resize(count);
+    staged_interval_.resize(count);
+    double* rates = &staged_angular_[0];
+    double* intervals = &staged_interval_[0];
+    for (int i = 0; i < count; i++)
+    {
+        int slot = staged_slots_[i];
+        double x0 = sample_x_[slot] - center_x_;
+        double y0 = sample_y_[slot] - center_y_;
+        double x1 = xs[i] - center_x_;
+        double y1 = ys[i] - center_y_;
+        double sweep = -std::atan2(x0*y1 - y0*x1, x0*x1 + y0*y1);
+        // Seconds since the previous position, on the tracker clock if known
+        double dt = staged_time_[i] - sample_time_[slot];
+        if (std::isnan(dt))
+        {
+            dt = (time - update_time_[slot])*1e-9;
+        }
+        // NaN without a previous position, skipped when scattering
+        bool valid = (x0*x0 + y0*y0 >= min_radius*min_radius && x1*x1 + y1*y1 >= min_radius*min_radius &&
+                      dt > 0.0 && dt <= max_filter_gap);
+        rates[i] = valid ? sweep/dt : std::numeric_limits<double>::quiet_NaN();
+        intervals[i] = dt;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        int slot = staged_slots_[i];
+        heading_[slot] = staged_heading_[i];
+
+        // Seconds since the previous position, on the tracker clock if known
+        double dt = staged_time_[i] - sample_time_[slot];
+        if (std::isnan(dt))
+        {
+            dt = (time - update_time_[slot])*1e-9;
+        }
+        if (std::isnan(filter_x_[slot]) || dt > max_filter_gap)
+        {
+            // First position, or lost track: restart at rest
+            filter_x_[slot] = xs[i];
+            filter_y_[slot] = ys[i];
+            velocity_x_[slot] = 0.0;
+            velocity_y_[slot] = 0.0;
+        }
+        else if (dt > 0.0)
+        {
+            double residual_x = xs[i] - (filter_x_[slot] + velocity_x_[slot]*dt);
+            double residual_y = ys[i] - (filter_y_[slot] + velocity_y_[slot]*dt);
+            filter_x_[slot] += velocity_x_[slot]*dt + filter_alpha*residual_x;
+            filter_y_[slot] += velocity_y_[slot]*dt + filter_alpha*residual_y;
+            velocity_x_[slot] += filter_beta*residual_x/dt;
+            velocity_y_[slot] += filter_beta*residual_y/dt;
+        }
+        else
+        {
+            // Several positions within one commit, keep the velocity
+            filter_x_[slot] = xs[i];
+            filter_y_[slot] = ys[i];
+        }
+        sample_x_[slot] = xs[i];
+        sample_y_[slot] = ys[i];
+        sample_time_[slot] = staged_time_[i];
+        update_time_[slot] = time;
+
+        if (max_prediction_age_ > 0)
+        {
+            moveTo(slot, filter_x_[slot], filter_y_[slot]);
+        }
+        else
+        {
+            moveTo(slot, xs[i], ys[i]);
+        }
+
+        if (!std::isnan(rates[i]))
+        {
+            double& velocity = angular_velocity_[slot];
+            double gain = 1.0 - std::exp(-intervals[i]/angular_time_constant);
+            velocity += gain*(rates[i] - velocity);
+            if (velocity > direction_threshold)
+            {
+                setDirection(slot, 1);
+            }
+            else if (velocity < -direction_threshold)
+            {
+                setDirection(slot, -1);
+            }
+        }
+
+        history_[slot].push(QPointF(xs[i], ys[i]));
+
+        if (density_)
+        {
+            density_->splat(QPointF(xs[i], ys[i]));
+        }
+    }
+
+    // Keeps the capacity
+    staged_slots_.resize(0);
+    staged_x_.resize(0);
+    staged_y_.resize(0);
+    staged_heading_.resize(0);
+    staged_time_.resize(0);
+    staged_angular_.resize(0);
+    staged_interval_.resize(0);
+}
+
+bool EntityStore::predict(qint64 time)
+{
+    if (max_prediction_age_ <= 0)
+    {
+        return false;
+    }
+
+    bool extrapolating = false;
+    const int count = size();
+    for (int slot = 0; slot < count; slot++)
+    {
+        if (velocity_x_[slot] == 0.0 && velocity_y_[slot] == 0.0)
+        {
+            // At rest, or not positioned yet
+            continue;
+        }
+        qint64 age = time - update_time_[slot];
+        if (age < max_prediction_age_)
+        {
+            extrapolating = true;
+        }
+        else
+        {
+            // Stop where the agent was last expected
+            age = max_prediction_age_;
+        }
+        double seconds = std::max(Q_INT64_C(0), age)*1e-9;
+        moveTo(slot, filter_x_[slot] + velocity_x_[slot]*seconds,
+               filter_y_[slot] + velocity_y_[slot]*seconds);
+    }
+    return extrapolating;
+}
+
+QPointF EntityStore::position(int slot) const
+{
+    return QPointF(x_[slot], y_[slot]);
+}
+
+QPointF EntityStore::sample(int slot) const
+{
+    return QPointF(sample_x_[slot], sample_y_[slot]);
+}
+
+QPointF EntityStore::velocity(int slot) const
+{
+    return QPointF(velocity_x_[slot], velocity_y_[slot]);
+}
+
+double EntityStore::heading(int slot) const
+{
+    return heading_[slot];
+}
+
+int EntityStore::direction(int slot) const
+{
+    return direction_[slot];
+}
+
+double EntityStore::angularVelocity(int slot) const
+{
+    return angular_velocity_[slot];
+}
+
+int EntityStore::groupDirection() const
+{
+    if (ccw_count_ == cw_count_)
+    {
+        return 0;
+    }
+    return ccw_count_ > cw_count_ ? 1 : -1;
+}
+
+double EntityStore::polarization() const
+{
+    int known = ccw_count_ + cw_count_;
+    if (known == 0)
+    {
+        return 0.0;
+    }
+    return double(ccw_count_ - cw_count_)/known;
+}
+
+const EntityStore::History& EntityStore::history(int slot) const
+{
+    return history_[slot];
+}
+
+QRectF EntityStore::pose(int slot) const
+{
+    return poseAt(x_[slot], y_[slot]);
+}
+
+const SpatialGrid& EntityStore::grid() const
+{
+    if (grid_stale_)
+    {
+        grid_.rebuild(x_.empty() ? NULL : &x_[0], y_.empty() ? NULL : &y_[0], size());
+        grid_stale_ = false;
+    }
+    return grid_;
+}
+
+int EntityStore::pick(const QPointF& pos, double max_distance) const
+{
+    return grid().pick(pos.x(), pos.y(), max_distance);
+}
+
+double EntityStore::meanNeighbourDistance() const
+{
+    const SpatialGrid& index = grid();
+    double sum = 0.0;
+    int count = 0;
+    for (int slot = 0; slot < size(); slot++)
+    {
+        if (std::isnan(x_[slot]))
+        {
+            continue;
+        }
+        int neighbour;
+        double distance;
+        if (index.nearest(x_[slot], y_[slot], 1, &neighbour, &distance, slot) == 1)
+        {
+            sum += distance;
+            count++;
+        }
+    }
+    return count > 0 ? sum/count : std::numeric_limits<double>::quiet_NaN();
+}
+
+double EntityStore::alignment() const
+{
+    double sum_x = 0.0;
+    double sum_y = 0.0;
+    int moving = 0;
+    for (int slot = 0; slot < size(); slot++)
+    {
+        double speed = std::sqrt(velocity_x_[slot]*velocity_x_[slot] + velocity_y_[slot]*velocity_y_[slot]);
+        if (speed < min_speed)
+        {
+            continue;
+        }
+        sum_x += velocity_x_[slot]/speed;
+        sum_y += velocity_y_[slot]/speed;
+        moving++;
+    }
+    return moving > 0 ? std::sqrt(sum_x*sum_x + sum_y*sum_y)/moving : 0.0;
+}
+
+const std::vector<int>& EntityStore::dirtySlots() const
+{
+    return dirty_slots_;
+}
+
+QRectF EntityStore::paintedPose(int slot) const
+{
+    return poseAt(painted_x_[slot], painted_y_[slot]);
+}
+
+void EntityStore::clearDirty()
+{
+    for (size_t i = 0; i < dirty_slots_.size(); i++)
+    {
+        int slot = dirty_slots_[i];
+        painted_x_[slot] = x_[slot];
+        painted_y_[slot] = y_[slot];
+        dirty_[slot] = false;
+    }
+    dirty_slots_.resize(0);
+}
+
+void EntityStore::setDirection(int slot, int direction)
+{
+    int previous = direction_[slot];
+    if (previous == direction)
+    {
+        return;
+    }
+    if (previous > 0) ccw_count_--;
+    if (previous < 0) cw_count_--;
+    if (direction > 0) ccw_count_++;
+    if (direction < 0) cw_count_++;
+    direction_[slot] = static_cast<signed char>(direction);
+}
+
+void EntityStore::moveTo(int slot, double x, double y)
+{
+    if (x == x_[slot] && y == y_[slot])
+    {
+        return;
+    }
+    x_[slot] = x;
+    y_[slot] = y;
+    grid_stale_ = true;
+    if (!dirty_[slot])
+    {
+        dirty_[slot] = true;
+        dirty_slots_.push_back(slot);
+    }
+}
+
+QRectF EntityStore::poseAt(double x, double y) const
+{
+    if (std::isnan(x) || std::isnan(y))
+    {
+        // Not positioned yet
+        return QRectF();
+    }
+    return QRectF(x - sprite_size_.width()/2.0, y - sprite_size_.height()/2.0,
+                  sprite_size_.width(), sprite_size_.height());
+}
@@ -0,0 +1,53 @@
+#include "framerenderer.h"
+#include "scenerenderer.h"
+
+#include <QElapsedTimer>
+
+FrameRenderer::FrameRenderer(const SceneLayout& layout, QObject *parent)
+    : QObject(parent),
+      layout_(layout),
+      scene_(NULL),
+      back_(0)
+{
+
+}
+
+FrameRenderer::~FrameRenderer()
+{
+    delete scene_;
+}
+
+void FrameRenderer::render(const SceneState& state, const QRegion& damage, const QSize& size, qreal dpr)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!scene_)
+    {
+        scene_ = new SceneRenderer(layout_);
+    }
+
+    QSize device_size = size*dpr;
+    QRegion region = damage;
+    if (buffers_[back_].size() != device_size || buffers_[back_].devicePixelRatio() != dpr)
+    {
+        // Resized, start over with two fresh buffers
+        for (int i = 0; i < 2; i++)
+        {
+            buffers_[i] = QImage(device_size, QImage::Format_ARGB32_Premultiplied);
+            buffers_[i].setDevicePixelRatio(dpr);
+        }
+        region = QRegion(QRect(QPoint(0,0), size));
+        previous_damage_ = region;
+    }
+
+    // The back buffer holds the frame before last, so it has to catch up
+    // with the previous frame as well
+    QRegion paint_region = region + previous_damage_;
+    scene_->render(buffers_[back_], state, paint_region);
+
+    emit frameReady(buffers_[back_], region, timer.nsecsElapsed());
+
+    previous_damage_ = region;
+    back_ = 1 - back_;
+}
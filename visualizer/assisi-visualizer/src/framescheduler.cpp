@@ -0,0 +1,135 @@
+#include "framescheduler.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+FrameScheduler::FrameScheduler(QObject *parent)
+    : QObject(parent),
+      interval_(0),
+      next_frame_(0),
+      last_frame_(-1),
+      pending_(false),
+      animating_(false),
+      busy_(false),
+      continuous_(false),
+      dropped_(0),
+      window_start_(0),
+      window_frames_(0),
+      fps_(0.0)
+{
+    timer_.setSingleShot(true);
+    timer_.setTimerType(Qt::PreciseTimer);
+    connect(&timer_, &QTimer::timeout, this, &FrameScheduler::tick);
+    clock_.start();
+    setMaxFps(30);
+}
+
+void FrameScheduler::setMaxFps(double fps)
+{
+    // Also false for NaN
+    if (!(fps > 0.0))
+    {
+        qWarning() << "Ignored frame rate" << fps;
+        return;
+    }
+    // At least 1 ms per frame, which also keeps the interval finite
+    interval_ = static_cast<qint64>(1e9/std::min(fps, 1000.0));
+}
+
+double FrameScheduler::maxFps() const
+{
+    return 1e9/interval_;
+}
+
+double FrameScheduler::fps() const
+{
+    return fps_;
+}
+
+qint64 FrameScheduler::droppedFrames() const
+{
+    return dropped_;
+}
+
+void FrameScheduler::requestFrame()
+{
+    pending_ = true;
+    schedule();
+}
+
+void FrameScheduler::setAnimating(bool animating)
+{
+    animating_ = animating;
+    schedule();
+}
+
+void FrameScheduler::frameStarted()
+{
+    busy_ = true;
+}
+
+void FrameScheduler::frameFinished(qint64 render_time)
+{
+    busy_ = false;
+
+    // Skip the slots that passed while rendering, each counted once. The
+    // render time is already part of the elapsed time
+    Q_UNUSED(render_time);
+    qint64 now = clock_.nsecsElapsed();
+    qint64 missed = 0;
+    if (now > next_frame_)
+    {
+        missed = (now - next_frame_)/interval_;
+    }
+    dropped_ += missed;
+    next_frame_ += missed*interval_;
+
+    schedule();
+}
+
+void FrameScheduler::schedule()
+{
+    if (timer_.isActive() || busy_ || !(pending_ || animating_))
+    {
+        return;
+    }
+
+    qint64 delay = next_frame_ - clock_.nsecsElapsed();
+    // Round up to full milliseconds, never fire early
+    timer_.start(static_cast<int>(std::max<qint64>(0, (delay + 999999)/1000000)));
+}
+
+void FrameScheduler::tick()
+{
+    qint64 now = clock_.nsecsElapsed();
+    // After idling, animations start with a regular step
+    double dt = interval_/1e9;
+    if (continuous_)
+    {
+        dt = (now - last_frame_)/1e9;
+    }
+    last_frame_ = now;
+
+    // Keep the cadence, but never burst to catch up
+    next_frame_ += interval_;
+    if (next_frame_ < now)
+    {
+        next_frame_ = now + interval_;
+    }
+
+    window_frames_++;
+    if (now - window_start_ >= 1000000000)
+    {
+        fps_ = window_frames_*1e9/(now - window_start_);
+        window_start_ = now;
+        window_frames_ = 0;
+        emit statistics(fps_, dropped_);
+    }
+
+    pending_ = false;
+    emit frame(dt);
+    continuous_ = animating_;
+
+    schedule();
+}
@@ -0,0 +1,147 @@
+#include "historybenchmark.h"
+#include "entitystore.h"
+#include "ringbuffer.h"
+
+#include <QList>
+#include <QPointF>
+
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+
+//! Positions appended to every history
+const int updates = 1000;
+
+//! History of an agent as it used to be kept, newest first
+struct ListHistory
+{
+    QList<double> x;
+    QList<double> y;
+
+    void append(double px, double py)
+    {
+        x.push_front(px);
+        y.push_front(py);
+        if (x.size() > EntityStore::history_size)
+        {
+            x.pop_back();
+            y.pop_back();
+        }
+    }
+};
+
+//! Synthetic position of an agent, cheap enough not to dominate the timings
+QPointF positionAt(int agent, int update)
+{
+    return QPointF(agent + update*0.5, agent - update*0.25);
+}
+
+struct Timings
+{
+    double append;
+    double read;
+    double sum;
+};
+
+Timings timeLists(int agents)
+{
+    std::vector<ListHistory> histories(agents);
+    Timings timings;
+    Benchmark::Samples append;
+    Benchmark::Samples read;
+
+    append.start();
+    for (int u = 0; u < updates; u++)
+    {
+        for (int a = 0; a < agents; a++)
+        {
+            QPointF p = positionAt(a, u);
+            histories[a].append(p.x(), p.y());
+        }
+    }
+    timings.append = append.stop()/(double(agents)*updates);
+
+    timings.sum = 0.0;
+    read.start();
+    for (int u = 0; u < updates; u++)
+    {
+        for (int a = 0; a < agents; a++)
+        {
+            const ListHistory& history = histories[a];
+            for (int i = 0; i < history.x.size(); i++)
+            {
+                timings.sum += history.x.at(i) + history.y.at(i);
+            }
+        }
+    }
+    timings.read = read.stop()/(double(agents)*updates);
+    return timings;
+}
+
+Timings timeRings(int agents)
+{
+    std::vector<EntityStore::History> histories(agents);
+    Timings timings;
+    Benchmark::Samples append;
+    Benchmark::Samples read;
+
+    append.start();
+    for (int u = 0; u < updates; u++)
+    {
+        for (int a = 0; a < agents; a++)
+        {
+            histories[a].push(positionAt(a, u));
+        }
+    }
+    timings.append = append.stop()/(double(agents)*updates);
+
+    timings.sum = 0.0;
+    read.start();
+    for (int u = 0; u < updates; u++)
+    {
+        for (int a = 0; a < agents; a++)
+        {
+            const EntityStore::History& history = histories[a];
+            const int n = history.size();
+            const QPointF* points = history.last(n);
+            // Newest first, like the lists
+            for (int i = n - 1; i >= 0; i--)
+            {
+                timings.sum += points[i].x() + points[i].y();
+            }
+        }
+    }
+    timings.read = read.stop()/(double(agents)*updates);
+    return timings;
+}
+
+}
+
+HistoryBenchmark::HistoryBenchmark(int agents)
+    : agents_(agents)
+{
+
+}
+
+int HistoryBenchmark::run()
+{
+    std::printf("Appending %d positions to %d histories of %d positions\n",
+                updates, agents_, EntityStore::history_size);
+
+    Timings lists = timeLists(agents_);
+    Timings rings = timeRings(agents_);
+
+    std::printf("History              append        read all\n");
+    std::printf("%-13s %9.1f ns %12.1f ns\n", "QList", lists.append, lists.read);
+    std::printf("%-13s %9.1f ns %12.1f ns\n", "RingBuffer", rings.append, rings.read);
+
+    // Both have to hold the same positions
+    if (lists.sum != rings.sum)
+    {
+        std::printf("Histories differ\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,654 @@
+#include "ingestor.h"
+#include "bytespan.h"
+#include "positionbatch.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace nzmqt;
+
+namespace
+{
+
+typedef ZMQMultipartMessage::Frame Frame;
+
+//! Conflation key of position batches, which hold all agents
+const quint32 batch_key = 0xffffffff;
+
+ByteSpan span(const Frame& frame)
+{
+    return ByteSpan(frame.data, frame.size);
+}
+
+//! Parse "<name>:<CW|CCW>", +1 is CCW
+bool toDirection(const ByteSpan& token, double* direction)
+{
+    SpanTokenizer fields(token, ':');
+    ByteSpan name;
+    ByteSpan dir;
+    if (!fields.next(&name) || !fields.next(&dir) || !fields.atEnd())
+    {
+        return false;
+    }
+    dir = dir.trimmed();
+    if (dir.equals("CCW"))
+    {
+        *direction = 1;
+        return true;
+    }
+    if (dir.equals("CW"))
+    {
+        *direction = -1;
+        return true;
+    }
+    return false;
+}
+
+}
+
+Ingestor::Ingestor(const QList<QString>& addresses,
+                   const QList<QString>& topics,
+                   const QList<QString>& casu_names,
+                   QObject *parent)
+    : QObject(parent),
+      context_(NULL),
+      addresses_(addresses),
+      topics_(topics),
+      socket_(NULL),
+      spin_budget_(0),
+      flush_timer_(this),
+      queue_(2*max_batch_records),
+      wake_pending_(false),
+      pushed_(false),
+      dropped_(0),
+      received_(0),
+      coalesced_(0),
+      malformed_(0),
+      lost_batches_(0)
+{
+    // Resolve names once, messages are routed by id
+    for (int i = 0; i < casu_names.length(); i++)
+    {
+        addTopic(casu_names.at(i).toUtf8(), CasuTopic, i);
+    }
+    addTopic("cats", CatsTopic);
+    addTopic("FishPosition", FishTopic);
+    addTopic("CASUPosition", RibotTopic);
+
+    addDeviceHandler("Temp", &Ingestor::handleTemp, true);
+    addDeviceHandler("Peltier", &Ingestor::handlePeltier, true);
+    addDeviceHandler("IR", &Ingestor::handleIr, true);
+    addDeviceHandler("CommEth", &Ingestor::handleCommEth, false);
+
+    // Invalid if the schema changed, payloads are then parsed in full
+    temp_field_ = WireScanner::resolve(AssisiMsg::TemperatureArray::descriptor(), "temp");
+    setpoint_field_ = WireScanner::resolve(AssisiMsg::Temperature::descriptor(), "temp");
+    ir_field_ = WireScanner::resolve(AssisiMsg::RangeArray::descriptor(), "raw_value");
+
+    // Backstop for messages not handed over in a batch. A child of the
+    // ingestor, so it moves to the ingestion thread with it
+    flush_timer_.setSingleShot(true);
+    flush_timer_.setInterval(33);
+    connect(&flush_timer_, &QTimer::timeout, this, &Ingestor::flush);
+}
+
+Ingestor::~Ingestor()
+{
+    qDeleteAll(slots_);
+}
+
+SpscQueue<StateDelta>& Ingestor::queue()
+{
+    return queue_;
+}
+
+void Ingestor::rearm()
+{
+    wake_pending_.store(false);
+}
+
+quint64 Ingestor::droppedDeltas() const
+{
+    return dropped_.load();
+}
+
+void Ingestor::setTopicConflated(const QString& topic, bool conflated)
+{
+    QByteArray name = topic.toUtf8();
+    int id = topic_ids_.find(name.constData(), name.size());
+    if (id >= 0)
+    {
+        routes_[id].conflate = conflated;
+    }
+}
+
+void Ingestor::setDeviceConflated(const QString& device, bool conflated)
+{
+    QByteArray name = device.toUtf8();
+    int id = device_ids_.find(name.constData(), name.size());
+    if (id >= 0)
+    {
+        device_conflate_[id] = conflated;
+    }
+}
+
+void Ingestor::setFlushInterval(int msec)
+{
+    flush_timer_.setInterval(msec);
+}
+
+quint64 Ingestor::receivedMessages() const
+{
+    return received_.load();
+}
+
+quint64 Ingestor::coalescedMessages() const
+{
+    return coalesced_.load();
+}
+
+quint64 Ingestor::malformedMessages() const
+{
+    return malformed_.load();
+}
+
+quint64 Ingestor::lostBatches() const
+{
+    return lost_batches_.load();
+}
+
+void Ingestor::setSpinBudget(int usec)
+{
+    spin_budget_ = usec;
+    if (context_)
+    {
+        context_->setSpinBudget(spin_budget_);
+    }
+}
+
+void Ingestor::start()
+{
+    // Socket notifiers deliver messages as soon as they arrive, instead of
+    // polling. They belong to the thread that creates them.
+    context_ = new SocketNotifierZMQContext(this);
+    context_->setSpinBudget(spin_budget_);
+    context_->start();
+
+    socket_ = context_->createSocket(ZMQSocket::TYP_SUB, this);
+    socket_->setObjectName("Subscriber.Socket.socket(SUB)");
+    // Messages are parsed in place, without copying them into signals
+    socket_->setMessageHandler(this);
+
+    for (int i = 0; i < topics_.length(); i++)
+    {
+        socket_->subscribeTo(topics_.at(i));
+        qDebug() << "Subscribed to " << topics_.at(i);
+    }
+
+    for (int i = 0; i < addresses_.length(); i++)
+    {
+        socket_->connectTo(addresses_.at(i));
+        qDebug() << "Connected socket to address " << addresses_.at(i);
+    }
+}
+
+void Ingestor::handleMessage(ZMQSocket*, const ZMQMultipartMessage& message)
+{
+    if (message.size() < 2)
+    {
+        return;
+    }
+    received_++;
+
+    Frame name = message.frame(0);
+    int topic = topic_ids_.find(name.data, name.size);
+    if (topic < 0)
+    {
+        return;
+    }
+
+    // Position batches are a single frame after the topic, all other
+    // messages have four frames
+    if (message.size() < 4 && !isPositionBatch(topic, message))
+    {
+        return;
+    }
+    if (isPositionBatch(topic, message) && !acceptBatch(topic, message.frame(1)))
+    {
+        return;
+    }
+
+    int slot_id = conflationSlot(topic, message);
+    if (slot_id < 0)
+    {
+        if (dispatch(topic, message))
+        {
+            return;
+        }
+        // A batch that does not fit waits for the consumer, even on
+        // topics that are not conflated
+        slot_id = findSlot(topic, batch_key);
+    }
+
+    // Keep the newest message only, it is parsed when the batch ends
+    Slot* slot = slots_.at(slot_id);
+    if (slot->pending)
+    {
+        coalesced_++;
+    }
+    else
+    {
+        // Starting a timer allocates, so the backstop is only armed
+        // when the first message becomes pending, and left running
+        if (pending_.isEmpty() && !flush_timer_.isActive())
+        {
+            flush_timer_.start();
+        }
+        slot->pending = true;
+        pending_.append(slot_id);
+    }
+    slot->message.copy(message);
+}
+
+void Ingestor::handleBatchEnd(ZMQSocket*, int)
+{
+    // The socket is drained for now, parsing waits for nothing newer
+    flush();
+}
+
+void Ingestor::flush()
+{
+    // Also called by the backstop timer, which finds nothing pending
+    // if the batch end came first
+    int waiting = 0;
+    for (int i = 0; i < pending_.size(); i++)
+    {
+        Slot* slot = slots_.at(pending_.at(i));
+        if (!dispatch(slot->topic, slot->message))
+        {
+            // Position batch without room in the queue, try again later
+            pending_[waiting++] = pending_.at(i);
+            continue;
+        }
+        // Hand the buffers back to ZMQ
+        slot->message.clear();
+        slot->pending = false;
+    }
+    // Keeps the capacity
+    pending_.resize(waiting);
+    if (waiting > 0 && !flush_timer_.isActive())
+    {
+        flush_timer_.start();
+    }
+    notify();
+}
+
+int Ingestor::conflationSlot(int topic, const ZMQMultipartMessage& message)
+{
+    const Route& route = routes_.at(topic);
+    if (!route.conflate)
+    {
+        return -1;
+    }
+
+    quint32 key = 0;
+    switch (route.kind)
+    {
+    case CasuTopic:
+    {
+        Frame device = message.frame(1);
+        int device_id = device_ids_.find(device.data, device.size);
+        if (device_id < 0 || !device_conflate_.at(device_id))
+        {
+            return -1;
+        }
+        key = device_id;
+        break;
+    }
+    case FishTopic:
+    case RibotTopic:
+    {
+        // A batch holds all agents, it replaces the batch before it
+        if (isPositionBatch(topic, message))
+        {
+            key = batch_key;
+            break;
+        }
+        int agent = 0;
+        if (!span(message.frame(1)).toInt(&agent) || agent < 0)
+        {
+            return -1;
+        }
+        key = agent;
+        break;
+    }
+    default:
+        return -1;
+    }
+    return findSlot(topic, key);
+}
+
+int Ingestor::findSlot(int topic, quint32 key)
+{
+    quint64 slot_key = (quint64(topic) << 32) | key;
+    QHash<quint64,int>::const_iterator it = slot_ids_.constFind(slot_key);
+    if (it != slot_ids_.constEnd())
+    {
+        return it.value();
+    }
+
+    // First message of this key, slots are kept for reuse
+    Slot* slot = new Slot();
+    slot->topic = topic;
+    slots_.append(slot);
+    slot_ids_.insert(slot_key, slots_.size() - 1);
+    return slots_.size() - 1;
+}
+
+bool Ingestor::dispatch(int topic, const ZMQMultipartMessage& message)
+{
+    const Route& route = routes_.at(topic);
+    switch (route.kind)
+    {
+    case CasuTopic:
+    {
+        // Received message is from one of the CASUs
+        Frame device = message.frame(1);
+        int handler = device_ids_.find(device.data, device.size);
+        if (handler >= 0)
+        {
+            (this->*device_handlers_.at(handler))(route.casu, message.frame(3));
+        }
+        break;
+    }
+    case CatsTopic:
+        handleCatsMessage(message);
+        break;
+    case FishTopic:
+    case RibotTopic:
+    {
+        StateDelta::Type type = (route.kind == FishTopic ? StateDelta::FishPosition : StateDelta::RibotPosition);
+        if (isPositionBatch(topic, message))
+        {
+            return handlePositionBatch(type, message.frame(1));
+        }
+        handlePosition(type, message);
+        break;
+    }
+    }
+    return true;
+}
+
+bool Ingestor::isPositionBatch(int topic, const ZMQMultipartMessage& message) const
+{
+    TopicKind kind = routes_.at(topic).kind;
+    return (kind == FishTopic || kind == RibotTopic) && message.size() == 2;
+}
+
+bool Ingestor::acceptBatch(int topic, const Frame& data)
+{
+    PositionBatch batch;
+    if (!batch.read(data.data, data.size) || batch.count() > max_batch_records)
+    {
+        reportMalformed(routes_.at(topic).kind == FishTopic ? "FishPosition batch" : "CASUPosition batch", data);
+        return false;
+    }
+
+    // Drop repeated and late batches, unless the tracker restarted
+    Route& route = routes_[topic];
+    if (route.sequenced)
+    {
+        qint32 step = static_cast<qint32>(batch.sequence() - route.sequence);
+        if (step <= 0 && step > -1000)
+        {
+            return false;
+        }
+        if (step > 1)
+        {
+            lost_batches_ += step - 1;
+        }
+    }
+    route.sequence = batch.sequence();
+    route.sequenced = true;
+    return true;
+}
+
+void Ingestor::addTopic(const QByteArray& name, TopicKind kind, int casu)
+{
+    int id = topic_ids_.intern(name);
+    Route route;
+    route.kind = kind;
+    route.casu = casu;
+    // Events are parsed as they arrive, snapshots are conflated
+    route.conflate = (kind != CatsTopic);
+    route.sequence = 0;
+    route.sequenced = false;
+    if (id == routes_.size())
+    {
+        routes_.append(route);
+    }
+    else
+    {
+        routes_[id] = route;
+    }
+}
+
+void Ingestor::addDeviceHandler(const QByteArray& device, DeviceHandler handler, bool conflate)
+{
+    int id = device_ids_.intern(device);
+    if (id == device_handlers_.size())
+    {
+        device_handlers_.append(handler);
+        device_conflate_.append(conflate);
+    }
+    else
+    {
+        device_handlers_[id] = handler;
+        device_conflate_[id] = conflate;
+    }
+}
+
+void Ingestor::handleTemp(int casu, const Frame& data)
+{
+    // CASU temperature measurements, TEMP_WAX is #7
+    const int wax = 7;
+    double temps[wax + 1];
+    int count = WireScanner(data.data, data.size).values(temp_field_, temps, wax + 1);
+    if (count < 0)
+    {
+        if (!temps_.ParseFromArray(data.data, static_cast<int>(data.size)))
+        {
+            reportMalformed("Temp", data);
+            return;
+        }
+        count = temps_.temp_size();
+        if (count > wax)
+        {
+            temps[wax] = temps_.temp(wax);
+        }
+    }
+    if (count <= wax)
+    {
+        reportMalformed("Temp", data);
+        return;
+    }
+    StateDelta delta;
+    delta.type = StateDelta::CasuTemp;
+    delta.id = casu;
+    delta.count = 0;
+    delta.value[0] = temps[wax];
+    push(delta);
+}
+
+void Ingestor::handlePeltier(int casu, const Frame& data)
+{
+    // CASU temperature setpoint
+    StateDelta delta;
+    delta.type = StateDelta::CasuSetpoint;
+    delta.id = casu;
+    delta.count = 0;
+    if (!WireScanner(data.data, data.size).value(setpoint_field_, &delta.value[0]))
+    {
+        // Also taken for a missing field, which the parser reads as 0
+        if (!setpoint_.ParseFromArray(data.data, static_cast<int>(data.size)))
+        {
+            reportMalformed("Peltier", data);
+            return;
+        }
+        delta.value[0] = setpoint_.temp();
+    }
+    push(delta);
+}
+
+void Ingestor::handleIr(int casu, const Frame& data)
+{
+    // CASU IR readings, thresholded by the consumer
+    StateDelta delta;
+    delta.type = StateDelta::CasuIr;
+    delta.id = casu;
+    delta.count = WireScanner(data.data, data.size).values(ir_field_, delta.value, 6);
+    if (delta.count < 0)
+    {
+        if (!ranges_.ParseFromArray(data.data, static_cast<int>(data.size)))
+        {
+            reportMalformed("IR", data);
+            return;
+        }
+        delta.count = ranges_.raw_value_size();
+        for (int i = 0; i < std::min(delta.count, 6); i++)
+        {
+            delta.value[i] = ranges_.raw_value(i);
+        }
+    }
+    delta.count = std::min(delta.count, 6);
+    push(delta);
+}
+
+void Ingestor::handleCommEth(int casu, const Frame& data)
+{
+    // "fish:<dir>,fishCASU:<dir>"
+    SpanTokenizer parts(span(data), ',');
+    ByteSpan fish;
+    ByteSpan ribot;
+    StateDelta delta;
+    if (!parts.next(&fish) || !parts.next(&ribot) || !parts.atEnd() ||
+        !toDirection(fish, &delta.value[0]) || !toDirection(ribot, &delta.value[1]))
+    {
+        reportMalformed("CommEth", data);
+        return;
+    }
+    delta.type = StateDelta::CatsMessage;
+    delta.id = casu;
+    delta.count = 0;
+    push(delta);
+}
+
+void Ingestor::handleCatsMessage(const ZMQMultipartMessage& message)
+{
+    // Frame 2 is the CASU the message is about
+    Frame sender = message.frame(2);
+    int topic = topic_ids_.find(sender.data, sender.size);
+    if (topic < 0 || routes_.at(topic).kind != CasuTopic)
+    {
+        return;
+    }
+    double val = 0.0;
+    if (!span(message.frame(3)).toDouble(&val))
+    {
+        reportMalformed("cats", message.frame(3));
+        return;
+    }
+    StateDelta delta;
+    delta.type = StateDelta::CasuMessage;
+    delta.id = routes_.at(topic).casu;
+    delta.count = static_cast<int>(val*6);
+    push(delta);
+}
+
+void Ingestor::handlePosition(StateDelta::Type type, const ZMQMultipartMessage& message)
+{
+    StateDelta delta;
+    delta.type = type;
+    delta.count = 0;
+    delta.value[2] = std::numeric_limits<double>::quiet_NaN();
+    delta.value[3] = std::numeric_limits<double>::quiet_NaN();
+    if (!span(message.frame(1)).toInt(&delta.id) ||
+        !span(message.frame(2)).toDouble(&delta.value[0]) ||
+        !span(message.frame(3)).toDouble(&delta.value[1]) ||
+        !std::isfinite(delta.value[0]) || !std::isfinite(delta.value[1]))
+    {
+        reportMalformed(type == StateDelta::FishPosition ? "FishPosition" : "CASUPosition", message.frame(1));
+        return;
+    }
+    push(delta);
+}
+
+bool Ingestor::handlePositionBatch(StateDelta::Type type, const Frame& data)
+{
+    // Checked by acceptBatch() on arrival
+    PositionBatch batch;
+    batch.read(data.data, data.size);
+    // Only the producer fills the queue, the room can only grow meanwhile
+    if (queue_.capacity() - queue_.size() < std::size_t(batch.count()))
+    {
+        return false;
+    }
+
+    StateDelta delta;
+    delta.type = type;
+    delta.count = 0;
+    delta.value[3] = batch.timestamp()*1e-6;
+    for (int i = 0; i < batch.count(); i++)
+    {
+        PositionBatch::Record record = batch.record(i);
+        if (!std::isfinite(record.x) || !std::isfinite(record.y))
+        {
+            // Not placeable, the agent keeps its last position
+            continue;
+        }
+        delta.id = record.id;
+        delta.value[0] = record.x;
+        delta.value[1] = record.y;
+        delta.value[2] = record.heading;
+        push(delta);
+    }
+    return true;
+}
+
+void Ingestor::reportMalformed(const char* what, const Frame& data)
+{
+    // Warn at 1, 2, 4, 8, ... so a broken publisher cannot flood the log
+    quint64 count = ++malformed_;
+    if ((count & (count - 1)) == 0)
+    {
+        qWarning() << "Ignored" << count << "malformed messages, last:" << what
+                   << QByteArray(data.data, static_cast<int>(std::min<size_t>(data.size, 64)));
+    }
+}
+
+void Ingestor::push(const StateDelta& delta)
+{
+    if (!queue_.push(delta))
+    {
+        // The consumer is far behind, newer data will follow
+        dropped_++;
+        return;
+    }
+    pushed_ = true;
+}
+
+void Ingestor::notify()
+{
+    // One signal per batch, not per delta
+    if (pushed_)
+    {
+        pushed_ = false;
+        if (!wake_pending_.exchange(true))
+        {
+            emit deltasAvailable();
+        }
+    }
+}
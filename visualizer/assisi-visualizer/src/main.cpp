@@ -1,11 +1,168 @@
 #include "visualizer.h"
+#include "renderbenchmark.h"
+#include "decodebenchmark.h"
+#include "historybenchmark.h"
+#include "spatialbenchmark.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QScopedPointer>
+
+#include <cstring>
+
+namespace
+{
+
+//! Returns the value of option, showing the help and exiting if it is not an integer of at least minimum
+int intValue(QCommandLineParser& parser, const QCommandLineOption& option, int minimum)
+{
+    bool ok = false;
+    int value = parser.value(option).toInt(&ok);
+    if (!ok || value < minimum)
+    {
+        parser.showHelp(1);
+    }
+    return value;
+}
+
+}
 
 int main(int argc, char *argv[])
 {
+    // Headless runs must not need a display, so the platform
+    // has to be chosen before the application is created
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--headless") == 0 ||
+            std::strcmp(argv[i], "--decode") == 0 ||
+            std::strcmp(argv[i], "--history") == 0 ||
+            std::strcmp(argv[i], "--spatial") == 0)
+        {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+    }
+
     QApplication a(argc, argv);
 
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Assisi experiment visualization");
+    parser.addHelpOption();
+    QCommandLineOption stress_option("stress",
+                                     "Replace the fish by <agents> synthetic ones and report render times.",
+                                     "agents");
+    parser.addOption(stress_option);
+    QCommandLineOption fps_option("fps",
+                                  "Render at most <fps> frames per second (default 30).",
+                                  "fps", "30");
+    parser.addOption(fps_option);
+    QCommandLineOption spin_option("spin",
+                                   "Busy wait up to <usec> microseconds for further messages (default 0).",
+                                   "usec", "0");
+    parser.addOption(spin_option);
+    QCommandLineOption predict_option("predict",
+                                      "Extrapolate agent positions up to <msec> milliseconds between tracker updates, "
+                                      "0 disables (default 250).",
+                                      "msec", "250");
+    parser.addOption(predict_option);
+
+    // Headless render benchmark
+    QCommandLineOption headless_option("headless",
+                                       "Render synthetic scenes offscreen and report frame times.");
+    parser.addOption(headless_option);
+    QCommandLineOption frames_option("frames", "Headless: number of frames (default 300).", "frames", "300");
+    parser.addOption(frames_option);
+    QCommandLineOption fish_option("fish", "Headless: number of fish (default 5).", "fish", "5");
+    parser.addOption(fish_option);
+    QCommandLineOption ribots_option("ribots", "Headless: number of ribots (default 1).", "ribots", "1");
+    parser.addOption(ribots_option);
+    QCommandLineOption casus_option("casus", "Headless: number of CASUs (default 2).", "casus", "2");
+    parser.addOption(casus_option);
+    QCommandLineOption size_option("size", "Headless: frame size (default 1600x1000).", "WxH", "1600x1000");
+    parser.addOption(size_option);
+    QCommandLineOption dpr_option("dpr", "Headless: device pixel ratio (default 1).", "ratio", "1");
+    parser.addOption(dpr_option);
+    QCommandLineOption dump_option("dump", "Headless: save every frame as png into <dir>.", "dir");
+    parser.addOption(dump_option);
+
+    // Message decoding benchmark
+    QCommandLineOption decode_option("decode",
+                                     "Decode synthetic messages and report time and allocations per message.");
+    parser.addOption(decode_option);
+    QCommandLineOption messages_option("messages", "Decode: messages per type (default 1000000).",
+                                       "messages", "1000000");
+    parser.addOption(messages_option);
+
+    // Position history benchmark
+    QCommandLineOption history_option("history",
+                                      "Append positions to the histories of <agents> agents and report times.",
+                                      "agents");
+    parser.addOption(history_option);
+
+    // Spatial index benchmark
+    QCommandLineOption spatial_option("spatial",
+                                      "Index <agents> synthetic agents at 30 Hz and report neighbour query times.",
+                                      "agents");
+    parser.addOption(spatial_option);
+
+    parser.process(a);
+
+    QScopedPointer<Benchmark> benchmark;
+    if (parser.isSet(spatial_option))
+    {
+        benchmark.reset(new SpatialBenchmark(intValue(parser, spatial_option, 1)));
+    }
+    else if (parser.isSet(history_option))
+    {
+        benchmark.reset(new HistoryBenchmark(intValue(parser, history_option, 1)));
+    }
+    else if (parser.isSet(decode_option))
+    {
+        benchmark.reset(new DecodeBenchmark(intValue(parser, messages_option, 1)));
+    }
+    else if (parser.isSet(headless_option))
+    {
+        RenderBenchmark::Options options;
+        options.frames = parser.value(frames_option).toInt();
+        options.fish = parser.value(fish_option).toInt();
+        options.ribots = parser.value(ribots_option).toInt();
+        options.casus = parser.value(casus_option).toInt();
+        QStringList size = parser.value(size_option).split('x');
+        if (size.length() == 2)
+        {
+            options.size = QSize(size.at(0).toInt(), size.at(1).toInt());
+        }
+        options.dpr = parser.value(dpr_option).toDouble();
+        options.dump_dir = parser.value(dump_option);
+        if (options.frames < 1 || options.size.isEmpty() || options.dpr <= 0.0)
+        {
+            parser.showHelp(1);
+        }
+        benchmark.reset(new RenderBenchmark(options));
+    }
+    if (benchmark)
+    {
+        return benchmark->run();
+    }
+
+    // Checked before the visualizer connects
+    bool fps_ok = false;
+    double fps = parser.value(fps_option).toDouble(&fps_ok);
+    if (!fps_ok || !(fps > 0.0))
+    {
+        parser.showHelp(1);
+    }
+    int spin = intValue(parser, spin_option, 0);
+    int predict = intValue(parser, predict_option, 0);
+    // Replacing the fish by no agents would only hide the tracked ones
+    int stress_agents = parser.isSet(stress_option) ? intValue(parser, stress_option, 1) : 0;
+
     Visualizer v("dummy.cfg");
+    v.setMaxFps(fps);
+    v.setReceiveSpin(spin);
+    v.setPrediction(predict);
+    if (stress_agents > 0)
+    {
+        v.startStressTest(stress_agents);
+    }
 
     v.show();
 
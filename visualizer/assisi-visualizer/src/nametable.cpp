@@ -0,0 +1,90 @@
+#include "nametable.h"
+
+#include <cstring>
+
+NameTable::NameTable()
+{
+    rehash(16);
+}
+
+int NameTable::intern(const QByteArray& name)
+{
+    int id = find(name.constData(), name.size());
+    if (id >= 0)
+    {
+        return id;
+    }
+
+    id = names_.size();
+    names_.append(name);
+    hashes_.append(hash(name.constData(), name.size()));
+    if (2*names_.size() > slots_.size())
+    {
+        rehash(2*slots_.size());
+    }
+    else
+    {
+        int mask = slots_.size() - 1;
+        int slot = hashes_.at(id) & mask;
+        while (slots_.at(slot) != 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+        slots_[slot] = id + 1;
+    }
+    return id;
+}
+
+int NameTable::find(const char* data, std::size_t size) const
+{
+    quint32 h = hash(data, size);
+    int mask = slots_.size() - 1;
+    for (int slot = h & mask; slots_.at(slot) != 0; slot = (slot + 1) & mask)
+    {
+        int id = slots_.at(slot) - 1;
+        const QByteArray& name = names_.at(id);
+        if (hashes_.at(id) == h && static_cast<std::size_t>(name.size()) == size &&
+            std::memcmp(name.constData(), data, size) == 0)
+        {
+            return id;
+        }
+    }
+    return -1;
+}
+
+int NameTable::size() const
+{
+    return names_.size();
+}
+
+const QByteArray& NameTable::name(int id) const
+{
+    return names_.at(id);
+}
+
+quint32 NameTable::hash(const char* data, std::size_t size)
+{
+    // 32 bit FNV-1a
+    quint32 h = 2166136261u;
+    for (std::size_t i = 0; i < size; i++)
+    {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void NameTable::rehash(int capacity)
+{
+    slots_.fill(0, capacity);
+    int mask = capacity - 1;
+    for (int id = 0; id < names_.size(); id++)
+    {
+        int slot = hashes_.at(id) & mask;
+        while (slots_.at(slot) != 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+        slots_[slot] = id + 1;
+    }
+}
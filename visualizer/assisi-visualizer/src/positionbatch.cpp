@@ -0,0 +1,98 @@
+#include "positionbatch.h"
+
+#include <QtEndian>
+
+#include <cstring>
+
+namespace
+{
+
+float toFloat(quint32 bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+quint32 toBits(float value)
+{
+    quint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+}
+
+PositionBatch::PositionBatch()
+    : data_(NULL),
+      sequence_(0),
+      timestamp_(0),
+      count_(0)
+{
+
+}
+
+bool PositionBatch::read(const char* data, std::size_t size)
+{
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    if (size < std::size_t(header_size))
+    {
+        return false;
+    }
+    int count = qFromLittleEndian<quint16>(bytes + 12);
+    if (size < std::size_t(header_size + count*record_size))
+    {
+        return false;
+    }
+
+    data_ = bytes;
+    sequence_ = qFromLittleEndian<quint32>(bytes);
+    timestamp_ = qFromLittleEndian<qint64>(bytes + 4);
+    count_ = count;
+    return true;
+}
+
+quint32 PositionBatch::sequence() const
+{
+    return sequence_;
+}
+
+qint64 PositionBatch::timestamp() const
+{
+    return timestamp_;
+}
+
+int PositionBatch::count() const
+{
+    return count_;
+}
+
+PositionBatch::Record PositionBatch::record(int index) const
+{
+    const unsigned char* bytes = data_ + header_size + index*record_size;
+    Record record;
+    record.id = qFromLittleEndian<qint32>(bytes);
+    record.x = toFloat(qFromLittleEndian<quint32>(bytes + 4));
+    record.y = toFloat(qFromLittleEndian<quint32>(bytes + 8));
+    record.heading = toFloat(qFromLittleEndian<quint32>(bytes + 12));
+    return record;
+}
+
+QByteArray PositionBatch::write(quint32 sequence, qint64 timestamp, const QVector<Record>& records)
+{
+    int count = qMin(records.size(), 0xffff);
+    QByteArray frame(header_size + count*record_size, '\0');
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(frame.data());
+    qToLittleEndian<quint32>(sequence, bytes);
+    qToLittleEndian<qint64>(timestamp, bytes + 4);
+    qToLittleEndian<quint16>(count, bytes + 12);
+    for (int i = 0; i < count; i++)
+    {
+        unsigned char* record = bytes + header_size + i*record_size;
+        qToLittleEndian<qint32>(records.at(i).id, record);
+        qToLittleEndian<quint32>(toBits(records.at(i).x), record + 4);
+        qToLittleEndian<quint32>(toBits(records.at(i).y), record + 8);
+        qToLittleEndian<quint32>(toBits(records.at(i).heading), record + 12);
+    }
+    return frame;
+}
@@ -0,0 +1,176 @@
+#include "renderbenchmark.h"
+#include "scenerenderer.h"
+
+#include <QDir>
+#include <QImage>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+RenderBenchmark::Options::Options(void)
+    : frames(300),
+      fish(5),
+      ribots(1),
+      casus(2),
+      size(1600, 1000),
+      dpr(1.0)
+{
+
+}
+
+RenderBenchmark::RenderBenchmark(const Options& options)
+    : options_(options)
+{
+
+}
+
+int RenderBenchmark::run()
+{
+    SceneLayout scene_layout = layout(options_.casus);
+    SceneRenderer renderer(scene_layout);
+
+    QImage frame(options_.size*options_.dpr, QImage::Format_ARGB32_Premultiplied);
+    frame.setDevicePixelRatio(options_.dpr);
+    QRegion region(QRect(QPoint(0,0), options_.size));
+
+    if (!options_.dump_dir.isEmpty() && !QDir().mkpath(options_.dump_dir))
+    {
+        std::fprintf(stderr, "Cannot create directory %s\n", qPrintable(options_.dump_dir));
+        return 1;
+    }
+
+    std::printf("Rendering %d frames of %dx%d (dpr %.2f): %d fish, %d ribots, %d CASUs\n",
+                options_.frames, options_.size.width(), options_.size.height(), options_.dpr,
+                options_.fish, options_.ribots, options_.casus);
+
+    // The first frame rasterizes sprites and static layers, report it separately
+    qint64 first_frame = 0;
+    Samples times;
+    times.reserve(options_.frames);
+    for (int f = 0; f < options_.frames; f++)
+    {
+        // Building the state is not part of the measurement
+        SceneState scene_state = state(scene_layout, options_, f);
+
+        times.start();
+        renderer.render(frame, scene_state, region);
+        qint64 elapsed = times.elapsed();
+
+        if (f == 0)
+        {
+            first_frame = elapsed;
+        }
+        else
+        {
+            times.add(elapsed);
+        }
+
+        if (!options_.dump_dir.isEmpty())
+        {
+            frame.save(QDir(options_.dump_dir).filePath(QString("frame_%1.png").arg(f, 5, 10, QChar('0'))));
+        }
+    }
+
+    std::printf("first frame: %8.3f ms\n", first_frame/1e6);
+    std::printf("mean:        %8.3f ms\n", times.mean()/1e6);
+    std::printf("p50:         %8.3f ms\n", times.percentile(0.50)/1e6);
+    std::printf("p95:         %8.3f ms\n", times.percentile(0.95)/1e6);
+    std::printf("p99:         %8.3f ms\n", times.percentile(0.99)/1e6);
+    std::printf("max:         %8.3f ms\n", times.max()/1e6);
+    return 0;
+}
+
+SceneLayout RenderBenchmark::layout(int casus)
+{
+    SceneLayout scene_layout;
+    if (casus == scene_layout.casus.size())
+    {
+        return scene_layout;
+    }
+
+    // Grid with roughly square cells in the bee arena
+    scene_layout.casus.clear();
+    const QRect& arena = scene_layout.bee_arena;
+    int cols = std::max(1, static_cast<int>(std::ceil(std::sqrt(casus*arena.width()/double(arena.height())))));
+    int rows = std::max(1, (casus + cols - 1)/cols);
+    int cell = std::min(arena.width()/cols, arena.height()/rows);
+    int body = std::max(1, cell/3);
+    for (int c = 0; c < casus; c++)
+    {
+        SceneLayout::Casu casu;
+        casu.name = QString("casu-%1").arg(c + 1, 3, 10, QChar('0'));
+        QPoint center(arena.left() + cell*(c % cols) + cell/2,
+                      arena.top() + cell*(c / cols) + cell/2);
+        casu.body.setRect(center.x() - body/2, center.y() - body/2, body, body);
+        casu.heating_area = casu.body.marginsAdded(QMargins(body, body, body, body));
+        scene_layout.casus.append(casu);
+    }
+    return scene_layout;
+}
+
+SceneState RenderBenchmark::state(const SceneLayout& layout, const Options& options, int frame)
+{
+    SceneState scene_state;
+    double t = frame/30.0;
+
+    // Agents swim on circles around the tank center
+    QPointF tank_center = QRectF(layout.fish_tank_outer).center();
+    double max_radius = std::min(layout.fish_tank_outer.width(), layout.fish_tank_outer.height())/2.0;
+    int agents = options.fish + options.ribots;
+    for (int i = 0; i < agents; i++)
+    {
+        double radius = max_radius*(0.3 + 0.6*std::fmod(i*0.618, 1.0));
+        double speed = (i % 2 ? 1.0 : -1.0)*(0.3 + std::fmod(i*0.618, 0.7));
+        double angle = i*2.399 + speed*t;
+        QRectF pose(0, 0, 100, 30);
+        pose.moveCenter(tank_center + QPointF(radius*std::cos(angle), radius*std::sin(angle)));
+        if (i < options.fish)
+        {
+            scene_state.fish.append(pose);
+        }
+        else
+        {
+            scene_state.ribots.append(pose);
+        }
+    }
+    scene_state.fish_direction = (frame/60) % 2 ? -1 : 1;
+    scene_state.ribot_direction = -scene_state.fish_direction;
+
+    // CASU readings change, messages to CATS travel along the arrows
+    double msg_x = 600 + std::fmod(t*120.0, 400.0);
+    scene_state.casus.resize(layout.casus.size());
+    for (int c = 0; c < layout.casus.size(); c++)
+    {
+        SceneState::Casu& casu = scene_state.casus[c];
+        casu.temp = 32 + 8*std::sin(t + c);
+        casu.temp_ref = 32 + 8*std::cos(t + c);
+        for (unsigned i = 0; i < casu.ir_ranges.size(); i++)
+        {
+            casu.ir_ranges[i] = ((frame/10 + c + i) % 3) ? 0.0 : 2.0;
+        }
+        casu.msg.active = true;
+        casu.msg.count = (frame/30 + c) % 7;
+        casu.msg.pose.setRect(msg_x - 95/2.0, layout.casus.at(c).body.center().y() - 95/2.0, 95, 95);
+    }
+
+    // CATS message to both CASUs
+    SceneState::CatsMessage& cats = scene_state.cats_msg;
+    double w = 160;
+    double h = 80;
+    double x = 950 - std::fmod(t*120.0, 350.0);
+    double dy = std::max(0.0, 800 - x)*0.75;
+    cats.active = true;
+    cats.fish_direction = scene_state.fish_direction;
+    cats.ribot_direction = scene_state.ribot_direction;
+    cats.rot_fish = -360*t*cats.fish_direction;
+    cats.rot_ribot = -360*t*cats.ribot_direction;
+    cats.pose_top.setRect(x-w/2.0, 500-dy-h/2.0, w, h);
+    cats.pose_bot.setRect(x-w/2.0, 500+dy-h/2.0, w, h);
+    cats.ribot_dir_top.setRect(x-w/2.0, 500-dy-h/2.0, w/2.0, h);
+    cats.ribot_dir_bot.setRect(x-w/2.0, 500+dy-h/2.0, w/2.0, h);
+    cats.fish_dir_top.setRect(x, 500-dy-h/2.0, w/2.0, h);
+    cats.fish_dir_bot.setRect(x, 500+dy-h/2.0, w/2.0, h);
+
+    return scene_state;
+}
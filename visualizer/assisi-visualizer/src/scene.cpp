@@ -0,0 +1,61 @@
+#include "scene.h"
+
+#include <QMargins>
+
+SceneLayout::SceneLayout(void)
+    : width(1600),
+      height(1000)
+{
+    fish_tank_outer.setRect(1040, 50, 480, 900);
+    fish_tank_inner.setRect(1160, 170, 240, 660);
+
+    bee_arena.setRect(80, 50, 480, 900);
+
+    Casu casu_top;
+    casu_top.name = "casu-001";
+    casu_top.body.setRect(260, 225, 100, 100);
+    casu_top.heating_area = casu_top.body.marginsAdded(QMargins(100,100,100,100));
+    casus.append(casu_top);
+
+    Casu casu_bottom;
+    casu_bottom.name = "casu-002";
+    casu_bottom.body.setRect(260, 675, 100, 100);
+    casu_bottom.heating_area = casu_bottom.body.marginsAdded(QMargins(100,100,100,100));
+    casus.append(casu_bottom);
+
+    double_arrow.setRect(800-200, 500-200, 400, 400);
+    top_arrow.setRect(800-200, 200-65, 400, 130);
+    bottom_arrow.setRect(800-200, 800-65, 400, 130);
+}
+
+SceneState::SceneState(void)
+    : fish_direction(1),
+      ribot_direction(1)
+{
+
+}
+
+SceneState::Message::Message(void)
+    : active(false),
+      count(0)
+{
+
+}
+
+SceneState::CatsMessage::CatsMessage(void)
+    : active(false),
+      fish_direction(1),
+      ribot_direction(1),
+      rot_fish(0),
+      rot_ribot(0)
+{
+
+}
+
+SceneState::Casu::Casu(void)
+    : temp(27),
+      temp_ref(27),
+      ir_ranges(6, 0.0)
+{
+
+}
@@ -0,0 +1,277 @@
+#include "scenerenderer.h"
+
+#include <QPainter>
+
+#include <cmath>
+
+const double deg_to_rad = M_PI/180;
+
+SceneRenderer::SceneRenderer(const SceneLayout& layout)
+    : layout_(layout),
+      agents_(atlas_)
+{
+    atlas_.loadResources();
+
+    // Index 0 is CW, 1 is CCW
+    fish_sprites_[0] = agents_.spriteId("fish-cw");
+    fish_sprites_[1] = agents_.spriteId("fish-ccw");
+    ribot_sprites_[0] = agents_.spriteId("ribot-cw");
+    ribot_sprites_[1] = agents_.spriteId("ribot-ccw");
+}
+
+void SceneRenderer::render(QImage& target, const SceneState& state, const QRegion& region)
+{
+    qreal dpr = target.devicePixelRatio();
+    // Scale all items
+    double scaling_x = target.width()/dpr/layout_.width;
+    double scaling_y = target.height()/dpr/layout_.height;
+
+    // Sprites and static layers are rasterized at device resolution
+    bool rescaled = atlas_.setScale(scaling_x*dpr, scaling_y*dpr);
+    if (rescaled || background_.size() != target.size())
+    {
+        renderStaticLayers(target.size(), dpr);
+    }
+
+    QPainter painter(&target);
+    painter.setClipRegion(region);
+
+    // Static background: fish tank, bee arena
+    painter.fillRect(region.boundingRect(), Qt::white);
+    painter.drawImage(QPointF(0,0), background_);
+
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.scale(scaling_x,
+                  scaling_y);
+    // Repainted area in scene coordinates, the painter clips to it anyway
+    QRectF exposed = painter.transform().inverted().mapRect(QRectF(region.boundingRect()));
+
+    // Where the fish have been, below the agents
+    if (!state.fish_density.isNull() && state.fish_density_area.intersects(exposed))
+    {
+        painter.save();
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.drawImage(state.fish_density_area, state.fish_density);
+        painter.restore();
+    }
+
+    // Draw fish and ribots
+    agents_.clear();
+    int fish_sprite = fish_sprites_[state.fish_direction > 0 ? 1 : 0];
+    for (int i = 0; i < state.fish.size(); i++)
+    {
+        if (!state.fish.at(i).intersects(exposed)) continue;
+        agents_.add(fish_sprite, state.fish.at(i));
+    }
+    int ribot_sprite = ribot_sprites_[state.ribot_direction > 0 ? 1 : 0];
+    for (int i = 0; i < state.ribots.size(); i++)
+    {
+        if (!state.ribots.at(i).intersects(exposed)) continue;
+        agents_.add(ribot_sprite, state.ribots.at(i));
+    }
+    agents_.draw(painter);
+
+    /* Draw CASU signals and bees */
+    int num_casus = std::min(layout_.casus.size(), state.casus.size());
+
+    // Draw casu heating areas
+    painter.setPen(Qt::NoPen);
+    for (int c = 0; c < num_casus; c++)
+    {
+        const QRect& heating_area = layout_.casus.at(c).heating_area;
+        double r = heating_area.height()/2.0;
+        QRadialGradient grad(heating_area.center(),r);
+        QColor color = tempToColor(state.casus.at(c).temp);
+        grad.setColorAt(0.0,color);
+        grad.setColorAt(0.75,color);
+        grad.setColorAt(1,QColor(255,255,255,0));
+        painter.setBrush(grad);
+        painter.drawEllipse(heating_area);
+    }
+
+    // Draw casu proximity readings
+    // This is horrible, and probably works only for 0.0 and 2.0 readings :(
+    painter.setBrush(QColor(150,150,150,100));
+    for (int c = 0; c < num_casus; c++)
+    {
+        const SceneLayout::Casu& casu = layout_.casus.at(c);
+        const std::vector<double>& ir_ranges = state.casus.at(c).ir_ranges;
+        unsigned num_readings = ir_ranges.size();
+        double fov = 360.0 / num_readings - 2;
+        int h = casu.heating_area.height();
+        for (unsigned i = 0; i < num_readings; i++)
+        {
+            QRect reading_area(casu.heating_area.topLeft(),casu.heating_area.bottomRight());
+            // ir_ranges[i] = 0 should show no reading (margin equal to area size)
+            // ir_ranges[i] = 2 is max reading (margin equal to 0.3 area size)
+            int margin = 0.5*h - 0.5*h*0.5*ir_ranges[i]*0.7;
+            reading_area = reading_area.marginsRemoved(QMargins(margin, margin, margin, margin));
+            painter.drawPie(reading_area,(60*i-fov/2)*16, fov*16);
+            if (ir_ranges[i] > 0.0)
+            {
+                // A bee has been detected, render it
+                double dx = reading_area.width()/2*cos(60*i*deg_to_rad);
+                double dy = -reading_area.width()/2*sin(60*i*deg_to_rad);
+                atlas_.draw(painter, "bee", QRectF(casu.body.topLeft(),QSizeF(93.0,65.0)).adjusted(dx,dy,dx,dy));
+            }
+        }
+    }
+
+    // Static overlay: temp scales, casu bodies, comm arrows
+    painter.save();
+    painter.resetTransform();
+    painter.drawImage(QPointF(0,0), overlay_);
+    painter.restore();
+
+    // Draw casu temperature setpoints
+    for (int c = 0; c < num_casus; c++)
+    {
+        drawRotatedSprite(painter, layout_.casus.at(c).body,
+                          tempToAngle(state.casus.at(c).temp_ref), QString("button"));
+    }
+
+    // Casu to cats
+    QFont font;
+    font.setPointSize(24);
+    painter.setFont(font);
+    for (int c = 0; c < num_casus; c++)
+    {
+        const SceneState::Message& msg = state.casus.at(c).msg;
+        if (msg.active)
+        {
+            atlas_.draw(painter, "msgcontainer", msg.pose);
+            painter.setPen(tempToColor(state.casus.at(c).temp));
+            painter.drawText(msg.pose,Qt::AlignCenter, QString::number(msg.count));
+        }
+    }
+
+    const SceneState::CatsMessage& msg_cats = state.cats_msg;
+    if (msg_cats.active)
+    {
+        // Render message containers
+        painter.setPen(Qt::NoPen);
+        atlas_.draw(painter, "msgcontainer2", msg_cats.pose_top);
+        atlas_.draw(painter, "msgcontainer2", msg_cats.pose_bot);
+
+        // Render ribot swim directions twice
+        QString ribot_dir_svg("msg-ribot-cw");
+        if (msg_cats.ribot_direction > 0)
+        {
+            ribot_dir_svg = "msg-ribot-ccw";
+        }
+        drawRotatedSprite(painter, msg_cats.ribot_dir_top,
+                          msg_cats.rot_ribot, ribot_dir_svg);
+        drawRotatedSprite(painter, msg_cats.ribot_dir_bot,
+                          msg_cats.rot_ribot, ribot_dir_svg);
+
+        // Render fish swim directions twice
+        QString fish_dir_svg = "msg-fish-cw";
+        if (msg_cats.fish_direction > 0)
+        {
+            fish_dir_svg = "msg-fish-ccw";
+        }
+        drawRotatedSprite(painter, msg_cats.fish_dir_top,
+                          msg_cats.rot_fish, fish_dir_svg);
+        drawRotatedSprite(painter, msg_cats.fish_dir_bot,
+                          msg_cats.rot_fish, fish_dir_svg);
+    }
+}
+
+void SceneRenderer::renderStaticLayers(const QSize& size, qreal dpr)
+{
+    // Layers are rendered in device pixels, and composited 1:1
+    double scaling_x = size.width()/dpr/layout_.width;
+    double scaling_y = size.height()/dpr/layout_.height;
+
+    background_ = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    background_.setDevicePixelRatio(dpr);
+    background_.fill(Qt::transparent);
+    overlay_ = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    overlay_.setDevicePixelRatio(dpr);
+    overlay_.fill(Qt::transparent);
+
+    QPainter painter(&background_);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.scale(scaling_x, scaling_y);
+
+    // Draw fish tank
+    atlas_.draw(painter, "fisharena2", layout_.fish_tank_outer);
+    painter.drawRect(layout_.fish_tank_outer);
+    //painter.drawRect(layout_.fish_tank_inner);
+
+    // Draw bee arena
+    atlas_.draw(painter, "beearena", layout_.bee_arena);
+    //painter.drawRect(layout_.bee_arena);
+    painter.end();
+
+    painter.begin(&overlay_);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.scale(scaling_x, scaling_y);
+    painter.setPen(Qt::NoPen);
+
+    QColor scale_color_min = tempToColor(24);
+    scale_color_min.setAlpha(255);
+    QColor scale_color_max = tempToColor(40);
+    scale_color_max.setAlpha(255);
+    for (int c = 0; c < layout_.casus.size(); c++)
+    {
+        const QRect& body = layout_.casus.at(c).body;
+        // Draw temp scale
+        QConicalGradient grad_tref(body.center(),270);
+        grad_tref.setColorAt(1,scale_color_min);
+        grad_tref.setColorAt(0,scale_color_max);
+        painter.setBrush(grad_tref);
+        painter.drawPie(body,-45*16,270*16);
+        // Draw casu body
+        painter.setBrush(QBrush(QColor(255,255,255)));
+        painter.drawPie(body,225*16,90*16);
+    }
+
+    // Draw comms
+    atlas_.draw(painter, "doublearrow", layout_.double_arrow);
+    atlas_.draw(painter, "arrow", layout_.top_arrow);
+    atlas_.draw(painter, "arrow", layout_.bottom_arrow);
+    painter.end();
+}
+
+void SceneRenderer::drawRotatedSprite(QPainter& painter,
+                                      const QRectF& area,
+                                      double angle,
+                                      const QString& resource_name)
+{
+    // Knobs and message icons turn continuously, blit pre-rendered
+    // frames instead of resampling the sprite for every angle
+    atlas_.drawRotated(painter, resource_name, area, angle);
+}
+
+QColor SceneRenderer::tempToColor(double temp)
+{
+    double temp_min = 24.0;
+    double temp_max = 40.0;
+    temp = clip(temp, temp_min, temp_max);
+
+    double hue_min = 240;
+    double hue_max = 380;
+    double k = (hue_max - hue_min) / (temp_max - temp_min);
+    int hue = k*(temp-temp_min) + hue_min;
+
+    QColor color;
+    color.setHsv(hue, 255, 255, 100);
+
+    return color;
+}
+
+double SceneRenderer::tempToAngle(double temp)
+{
+    double angle = 0.0;
+    double temp_min = 24.0;
+    double temp_max = 40.0;
+    temp = clip(temp, temp_min, temp_max);
+
+    double ang_min = 0.0;
+    double ang_max = 270.0;
+    double k = (ang_max - ang_min) / (temp_max - temp_min);
+    angle = k*(temp-temp_min) + ang_min;
+
+    return angle;
+}
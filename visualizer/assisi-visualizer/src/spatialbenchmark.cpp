@@ -0,0 +1,84 @@
+#include "spatialbenchmark.h"
+#include "entitystore.h"
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+namespace
+{
+
+const int frames = 300;
+//! Frame time of a 30 Hz tracker, in ns
+const qint64 frame_time = 33333333;
+//! Queries per frame, as if the cursor moved over the tank
+const int queries = 100;
+//! Time allowed for the neighbour work of a frame, in ns
+const qint64 budget = 1000000;
+
+}
+
+SpatialBenchmark::SpatialBenchmark(int agents)
+    : agents_(agents)
+{
+
+}
+
+int SpatialBenchmark::run()
+{
+    std::printf("Indexing %d agents for %d frames, %d picks and radius queries per frame\n",
+                agents_, frames, queries);
+
+    // Same tank transform as the tracked fish
+    EntityStore store;
+    store.setTransform(440.0/500.0, 900.0/500.0, 1055, 50);
+    store.setCenter(QPointF(1280, 500));
+    for (int i = 0; i < agents_; i++)
+    {
+        store.slot(i);
+    }
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    Samples times;
+    times.reserve(frames);
+    std::vector<int> found;
+    double checksum = 0.0;
+    for (int f = 0; f < frames; f++)
+    {
+        // Agents swim on circles around the tank center, as in the stress test
+        double t = f*frame_time*1e-9;
+        for (int i = 0; i < agents_; i++)
+        {
+            double radius = 20.0 + std::fmod(i*37.0, 220.0);
+            double speed = (i % 2 ? 1.0 : -1.0)*(0.3 + std::fmod(i*0.618, 0.7));
+            double angle = i*2.399 + speed*t;
+            store.stage(i, 250.0 + radius*std::cos(angle), 250.0 + radius*std::sin(angle), nan, t);
+        }
+        store.commit(f*frame_time);
+
+        times.start();
+        checksum += store.meanNeighbourDistance();
+        checksum += store.alignment();
+        for (int q = 0; q < queries; q++)
+        {
+            QPointF pos(1055.0 + std::fmod(q*17.3 + f, 440.0), 50.0 + std::fmod(q*43.7 + 3*f, 900.0));
+            checksum += store.pick(pos, 40.0);
+            checksum += store.grid().radius(pos.x(), pos.y(), 50.0, &found);
+        }
+        times.stop();
+    }
+    keep(checksum);
+
+    std::printf("Neighbour work per frame: mean %.3f ms, p99 %.3f ms, max %.3f ms (budget %.3f ms)\n",
+                times.mean()/1e6, times.percentile(0.99)/1e6, times.max()/1e6, budget/1e6);
+    std::printf("Mean nearest neighbour distance %.2f px, alignment %.2f, polarization %.2f\n",
+                store.meanNeighbourDistance(), store.alignment(), store.polarization());
+
+    if (times.mean() > budget)
+    {
+        std::printf("Over budget\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,272 @@
+#include "spatialgrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+
+//! Points per cell the cell size is chosen for
+const double points_per_cell = 2.0;
+
+}
+
+SpatialGrid::SpatialGrid()
+    : x0_(0.0),
+      y0_(0.0),
+      cell_size_(1.0),
+      cols_(1),
+      rows_(1),
+      cell_start_(2, 0),
+      size_(0)
+{
+
+}
+
+void SpatialGrid::rebuild(const double* xs, const double* ys, int count)
+{
+    // Bounding box of the points
+    double min_x = std::numeric_limits<double>::infinity();
+    double min_y = min_x;
+    double max_x = -min_x;
+    double max_y = -min_x;
+    int n = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (!std::isfinite(xs[i]) || !std::isfinite(ys[i]))
+        {
+            continue;
+        }
+        min_x = std::min(min_x, xs[i]);
+        max_x = std::max(max_x, xs[i]);
+        min_y = std::min(min_y, ys[i]);
+        max_y = std::max(max_y, ys[i]);
+        n++;
+    }
+
+    size_ = n;
+    point_cell_.assign(count, -1);
+    if (n == 0)
+    {
+        cols_ = 1;
+        rows_ = 1;
+        cell_start_.assign(2, 0);
+        points_.resize(0);
+        x_.resize(0);
+        y_.resize(0);
+        return;
+    }
+
+    // Cells for a few points each, also if the points lie on a line
+    double width = max_x - min_x;
+    double height = max_y - min_y;
+    cell_size_ = std::max(std::sqrt(width*height*points_per_cell/n),
+                          std::max(width, height)*points_per_cell/n);
+    if (!(cell_size_ > 0.0))
+    {
+        // All points in the same place
+        cell_size_ = 1.0;
+    }
+    x0_ = min_x;
+    y0_ = min_y;
+    cols_ = static_cast<int>(width/cell_size_) + 1;
+    rows_ = static_cast<int>(height/cell_size_) + 1;
+    const int cells = cols_*rows_;
+
+    // Counting sort by cell: count, prefix sum, scatter
+    cell_start_.assign(cells + 1, 0);
+    for (int i = 0; i < count; i++)
+    {
+        if (!std::isfinite(xs[i]) || !std::isfinite(ys[i]))
+        {
+            continue;
+        }
+        int cell = cellY(ys[i])*cols_ + cellX(xs[i]);
+        point_cell_[i] = cell;
+        cell_start_[cell + 1]++;
+    }
+    for (int c = 0; c < cells; c++)
+    {
+        cell_start_[c + 1] += cell_start_[c];
+    }
+    points_.resize(n);
+    x_.resize(n);
+    y_.resize(n);
+    for (int i = 0; i < count; i++)
+    {
+        int cell = point_cell_[i];
+        if (cell < 0)
+        {
+            continue;
+        }
+        int entry = cell_start_[cell]++;
+        points_[entry] = i;
+        x_[entry] = xs[i];
+        y_[entry] = ys[i];
+    }
+    // Each start has moved to the start of the next cell, move them back
+    for (int c = cells; c > 0; c--)
+    {
+        cell_start_[c] = cell_start_[c - 1];
+    }
+    cell_start_[0] = 0;
+}
+
+int SpatialGrid::size() const
+{
+    return size_;
+}
+
+int SpatialGrid::pick(double x, double y, double max_distance) const
+{
+    int best = -1;
+    double best_d2 = max_distance*max_distance;
+    int x_begin = cellX(x - max_distance);
+    int x_end = cellX(x + max_distance);
+    int y_begin = cellY(y - max_distance);
+    int y_end = cellY(y + max_distance);
+    for (int cy = y_begin; cy <= y_end; cy++)
+    {
+        for (int cx = x_begin; cx <= x_end; cx++)
+        {
+            int cell = cy*cols_ + cx;
+            for (int j = cell_start_[cell]; j < cell_start_[cell + 1]; j++)
+            {
+                double dx = x_[j] - x;
+                double dy = y_[j] - y;
+                double d2 = dx*dx + dy*dy;
+                if (d2 <= best_d2)
+                {
+                    best_d2 = d2;
+                    best = points_[j];
+                }
+            }
+        }
+    }
+    return best;
+}
+
+int SpatialGrid::radius(double x, double y, double distance, std::vector<int>* found) const
+{
+    found->resize(0);
+    double max_d2 = distance*distance;
+    int x_begin = cellX(x - distance);
+    int x_end = cellX(x + distance);
+    int y_begin = cellY(y - distance);
+    int y_end = cellY(y + distance);
+    for (int cy = y_begin; cy <= y_end; cy++)
+    {
+        for (int cx = x_begin; cx <= x_end; cx++)
+        {
+            int cell = cy*cols_ + cx;
+            for (int j = cell_start_[cell]; j < cell_start_[cell + 1]; j++)
+            {
+                double dx = x_[j] - x;
+                double dy = y_[j] - y;
+                if (dx*dx + dy*dy <= max_d2)
+                {
+                    found->push_back(points_[j]);
+                }
+            }
+        }
+    }
+    return static_cast<int>(found->size());
+}
+
+int SpatialGrid::nearest(double x, double y, int k, int* found, double* distances, int exclude) const
+{
+    if (k <= 0)
+    {
+        return 0;
+    }
+
+    // Rings of cells around the cell of (x, y), distances holds squared
+    // distances while searching
+    int n = 0;
+    int cx = cellX(x);
+    int cy = cellY(y);
+    // Distance from (x, y) to the border of its cell, 0 if outside the grid
+    double left = x - (x0_ + cx*cell_size_);
+    double top = y - (y0_ + cy*cell_size_);
+    double margin = std::min(std::min(left, cell_size_ - left), std::min(top, cell_size_ - top));
+    margin = std::max(margin, 0.0);
+    int max_ring = std::max(cols_, rows_);
+    for (int r = 0; r <= max_ring; r++)
+    {
+        // No point of ring r is closer than r - 1 cells past the margin
+        double ring_distance = (r - 1)*cell_size_ + margin;
+        if (n == k && r > 0 && distances[k - 1] <= ring_distance*ring_distance)
+        {
+            break;
+        }
+        for (int iy = std::max(cy - r, 0); iy <= std::min(cy + r, rows_ - 1); iy++)
+        {
+            // Cells of a row are stored back to back, so the whole first
+            // and last rows of the ring are one run, the others two cells
+            const int* row = &cell_start_[iy*cols_];
+            if (iy == cy - r || iy == cy + r)
+            {
+                scanEntries(row[std::max(cx - r, 0)], row[std::min(cx + r, cols_ - 1) + 1],
+                            x, y, k, found, distances, &n, exclude);
+                continue;
+            }
+            if (cx - r >= 0)
+            {
+                scanEntries(row[cx - r], row[cx - r + 1], x, y, k, found, distances, &n, exclude);
+            }
+            if (cx + r < cols_)
+            {
+                scanEntries(row[cx + r], row[cx + r + 1], x, y, k, found, distances, &n, exclude);
+            }
+        }
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        distances[i] = std::sqrt(distances[i]);
+    }
+    return n;
+}
+
+int SpatialGrid::cellX(double x) const
+{
+    // Clamped before the conversion, queries may be far outside
+    double cell = std::floor((x - x0_)/cell_size_);
+    return static_cast<int>(std::max(0.0, std::min(cell, cols_ - 1.0)));
+}
+
+int SpatialGrid::cellY(double y) const
+{
+    double cell = std::floor((y - y0_)/cell_size_);
+    return static_cast<int>(std::max(0.0, std::min(cell, rows_ - 1.0)));
+}
+
+void SpatialGrid::offer(int point, double d2, int k, int* found, double* d2s, int* n)
+{
+    // Insertion into the sorted list, dropping the farthest if full
+    int i = (*n < k ? (*n)++ : k - 1);
+    while (i > 0 && d2s[i - 1] > d2)
+    {
+        found[i] = found[i - 1];
+        d2s[i] = d2s[i - 1];
+        i--;
+    }
+    found[i] = point;
+    d2s[i] = d2;
+}
+
+void SpatialGrid::scanEntries(int begin, int end, double x, double y, int k, int* found, double* d2s, int* n,
+                              int exclude) const
+{
+    for (int j = begin; j < end; j++)
+    {
+        double dx = x_[j] - x;
+        double dy = y_[j] - y;
+        double d2 = dx*dx + dy*dy;
+        if ((*n < k || d2 < d2s[k - 1]) && points_[j] != exclude)
+        {
+            offer(points_[j], d2, k, found, d2s, n);
+        }
+    }
+}
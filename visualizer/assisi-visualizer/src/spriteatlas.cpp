@@ -0,0 +1,246 @@
+#include "spriteatlas.h"
+
+#include <QDebug>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QPainter>
+#include <QSvgRenderer>
+
+#include <algorithm>
+#include <cmath>
+
+SpriteAtlas::SpriteAtlas()
+    : scale_x_(1.0),
+      scale_y_(1.0),
+      angular_resolution_(2.0),
+      sheet_bytes_(0),
+      sheet_bytes_limit_(64*1024*1024)
+{
+
+}
+
+SpriteAtlas::~SpriteAtlas()
+{
+    for (QHash<QString,Sprite>::iterator it = sprites_.begin(); it != sprites_.end(); ++it)
+    {
+        delete it->renderer;
+    }
+}
+
+void SpriteAtlas::loadResources(const QString& prefix)
+{
+    QDirIterator it(prefix, QStringList() << "*.svg", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext())
+    {
+        QString path = it.next();
+        QString name = QFileInfo(path).baseName();
+        if (sprites_.contains(name))
+        {
+            continue;
+        }
+
+        QSvgRenderer* renderer = new QSvgRenderer(path);
+        if (!renderer->isValid())
+        {
+            qWarning() << "Could not parse sprite" << path;
+            delete renderer;
+            continue;
+        }
+        sprites_[name].renderer = renderer;
+    }
+    qDebug() << "Loaded" << sprites_.size() << "sprites from" << prefix;
+}
+
+bool SpriteAtlas::setScale(double scale_x, double scale_y)
+{
+    if (scale_x == scale_x_ && scale_y == scale_y_)
+    {
+        return false;
+    }
+
+    scale_x_ = scale_x;
+    scale_y_ = scale_y;
+    for (QHash<QString,Sprite>::iterator it = sprites_.begin(); it != sprites_.end(); ++it)
+    {
+        it->rasters.clear();
+    }
+    clearSheets();
+    return true;
+}
+
+const QImage& SpriteAtlas::sprite(const QString& name, const QSizeF& size)
+{
+    QHash<QString,Sprite>::iterator it = sprites_.find(name);
+    if (it == sprites_.end())
+    {
+        return null_image_;
+    }
+
+    QSize dev_size = deviceSize(size);
+    QList<Raster>& rasters = it->rasters;
+    for (int i = 0; i < rasters.size(); i++)
+    {
+        if (rasters.at(i).first == dev_size)
+        {
+            return rasters.at(i).second;
+        }
+    }
+
+    // First request at this size, rasterize
+    QImage image(dev_size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    it->renderer->render(&painter, QRectF(QPointF(0,0), dev_size));
+    painter.end();
+
+    rasters.append(Raster(dev_size, image));
+    return rasters.last().second;
+}
+
+void SpriteAtlas::draw(QPainter& painter, const QString& name, const QRectF& area)
+{
+    const QImage& image = sprite(name, area.size());
+    if (!image.isNull())
+    {
+        painter.drawImage(area, image);
+    }
+}
+
+void SpriteAtlas::setAngularResolution(double degrees)
+{
+    if (degrees > 0.0 && degrees != angular_resolution_)
+    {
+        angular_resolution_ = degrees;
+        clearSheets();
+    }
+}
+
+double SpriteAtlas::angularResolution() const
+{
+    return angular_resolution_;
+}
+
+void SpriteAtlas::setRotationCacheLimit(qint64 bytes)
+{
+    sheet_bytes_limit_ = bytes;
+}
+
+const QImage& SpriteAtlas::rotatedSprite(const QString& name, const QSizeF& size, double angle)
+{
+    QHash<QString,Sprite>::iterator it = sprites_.find(name);
+    if (it == sprites_.end())
+    {
+        return null_image_;
+    }
+
+    // Rotated in scene coordinates, scaled uniformly
+    double scale = sheetScale();
+    QSize dev_size(std::max(1, static_cast<int>(std::ceil(size.width()*scale))),
+                   std::max(1, static_cast<int>(std::ceil(size.height()*scale))));
+    QList<RotationSheet>& sheets = it->sheets;
+    int s = 0;
+    while (s < sheets.size() && sheets.at(s).size != dev_size)
+    {
+        s++;
+    }
+    if (s == sheets.size())
+    {
+        RotationSheet sheet;
+        sheet.size = dev_size;
+        sheet.frames.resize(std::max(1, static_cast<int>(std::ceil(360.0/angular_resolution_))));
+        sheets.append(sheet);
+    }
+    QVector<QImage>& frames = sheets[s].frames;
+
+    // Nearest frame, for any angle. The frames divide the turn evenly,
+    // also if the resolution does not
+    int num_frames = frames.size();
+    double step = 360.0/num_frames;
+    int index = static_cast<int>(std::floor(angle/step + 0.5)) % num_frames;
+    if (index < 0)
+    {
+        index += num_frames;
+    }
+
+    QImage& frame = frames[index];
+    if (frame.isNull())
+    {
+        // The frame has to hold the sprite at any angle
+        int side = static_cast<int>(std::ceil(std::sqrt(double(dev_size.width()*dev_size.width() +
+                                                               dev_size.height()*dev_size.height()))));
+        qint64 bytes = qint64(side)*side*4;
+        if (sheet_bytes_ + bytes > sheet_bytes_limit_)
+        {
+            return null_image_;
+        }
+        sheet_bytes_ += bytes;
+
+        frame = QImage(side, side, QImage::Format_ARGB32_Premultiplied);
+        frame.fill(Qt::transparent);
+        QPainter painter(&frame);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.translate(side/2.0, side/2.0);
+        painter.rotate(index*step);
+        it->renderer->render(&painter, QRectF(-dev_size.width()/2.0, -dev_size.height()/2.0,
+                                              dev_size.width(), dev_size.height()));
+    }
+    return frame;
+}
+
+void SpriteAtlas::drawRotated(QPainter& painter, const QString& name, const QRectF& area, double angle)
+{
+    const QImage& frame = rotatedSprite(name, area.size(), angle);
+    if (!frame.isNull())
+    {
+        // The painter applies the non-uniform scaling, after the rotation
+        QRectF target(0, 0, frame.width()/sheetScale(), frame.height()/sheetScale());
+        target.moveCenter(area.center());
+        painter.drawImage(target, frame);
+        return;
+    }
+
+    // Out of budget, rotate the upright raster
+    painter.save();
+    painter.translate(area.center());
+    painter.rotate(angle);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    QRectF centered(area);
+    centered.moveCenter(QPointF(0,0));
+    draw(painter, name, centered);
+    painter.restore();
+}
+
+double SpriteAtlas::sheetScale() const
+{
+    // Never fewer pixels than the blit covers
+    return std::max(scale_x_, scale_y_);
+}
+
+bool SpriteAtlas::contains(const QString& name) const
+{
+    return sprites_.contains(name);
+}
+
+QSize SpriteAtlas::deviceSize(const QSizeF& size) const
+{
+    // Never rasterize to an empty image
+    int w = std::max(1, static_cast<int>(std::ceil(size.width()*scale_x_)));
+    int h = std::max(1, static_cast<int>(std::ceil(size.height()*scale_y_)));
+    return QSize(w, h);
+}
+
+void SpriteAtlas::clearSheets()
+{
+    for (QHash<QString,Sprite>::iterator it = sprites_.begin(); it != sprites_.end(); ++it)
+    {
+        it->sheets.clear();
+    }
+    sheet_bytes_ = 0;
+}
+
+SpriteAtlas::Sprite::Sprite()
+    : renderer(NULL)
+{
+
+}
@@ -0,0 +1,156 @@
+#include "spritebatch.h"
+#include "spriteatlas.h"
+
+#include <QPaintDevice>
+#include <QPainter>
+
+#include <cmath>
+
+SpriteBatch::SpriteBatch(SpriteAtlas& atlas)
+    : atlas_(atlas)
+{
+
+}
+
+int SpriteBatch::spriteId(const QString& name)
+{
+    int id = sprites_.indexOf(name);
+    if (id < 0)
+    {
+        sprites_.append(name);
+        id = sprites_.size() - 1;
+    }
+    return id;
+}
+
+void SpriteBatch::clear()
+{
+    instances_.resize(0);
+}
+
+void SpriteBatch::add(int sprite, const QRectF& area, double rotation, double opacity)
+{
+    Instance instance;
+    instance.center = area.center();
+    instance.size = area.size();
+    instance.rotation = rotation;
+    instance.opacity = opacity;
+    instance.sprite = sprite;
+    instances_.append(instance);
+}
+
+int SpriteBatch::size() const
+{
+    return instances_.size();
+}
+
+void SpriteBatch::draw(QPainter& painter)
+{
+    if (instances_.isEmpty())
+    {
+        return;
+    }
+
+    // Counting sort of the instances by sprite, keeps the drawing order
+    // of instances within the same sprite
+    int num_sprites = sprites_.size();
+    bucket_start_.fill(0, num_sprites + 1);
+    for (int i = 0; i < instances_.size(); i++)
+    {
+        bucket_start_[instances_.at(i).sprite + 1]++;
+    }
+    for (int s = 0; s < num_sprites; s++)
+    {
+        bucket_start_[s + 1] += bucket_start_[s];
+    }
+    order_.resize(instances_.size());
+    for (int i = 0; i < instances_.size(); i++)
+    {
+        order_[bucket_start_[instances_.at(i).sprite]++] = i;
+    }
+
+    // Work in device pixels, so unrotated sprites are plain blits
+    qreal dpr = painter.device()->devicePixelRatioF();
+    QTransform scene = painter.transform();
+    QTransform to_device = painter.transform()*QTransform::fromScale(dpr, dpr);
+    QTransform device = QTransform::fromScale(1.0/dpr, 1.0/dpr);
+    // Rotation sheet frames are scaled uniformly, stretch them to the device
+    double frame_scale_x = to_device.m11()/atlas_.sheetScale();
+    double frame_scale_y = to_device.m22()/atlas_.sheetScale();
+    bool stretch_frames = (std::fabs(frame_scale_x - 1.0) > 1e-9 || std::fabs(frame_scale_y - 1.0) > 1e-9);
+
+    painter.save();
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    double opacity = painter.opacity();
+
+    int begin = 0;
+    for (int s = 0; s < num_sprites; s++)
+    {
+        // After sorting, bucket_start_[s] is the end of bucket s
+        int end = bucket_start_[s];
+        const QImage* image = NULL;
+        QSizeF image_size;
+        for (int k = begin; k < end; k++)
+        {
+            const Instance& instance = instances_.at(order_.at(k));
+            if (!image || instance.size != image_size)
+            {
+                image = &atlas_.sprite(sprites_.at(s), instance.size);
+                image_size = instance.size;
+            }
+            if (image->isNull())
+            {
+                continue;
+            }
+            if (instance.opacity != opacity)
+            {
+                opacity = instance.opacity;
+                painter.setOpacity(opacity);
+            }
+
+            QPointF center = to_device.map(instance.center);
+            QPointF half(image->width()/2.0, image->height()/2.0);
+            if (instance.rotation == 0.0)
+            {
+                painter.setTransform(device);
+                QPointF top_left = center - half;
+                painter.drawImage(QPointF(std::floor(top_left.x() + 0.5),
+                                          std::floor(top_left.y() + 0.5)), *image);
+            }
+            else
+            {
+                // Rotated instances are blits of the nearest frame of the
+                // sprite's rotation sheet, if the atlas could cache it
+                const QImage& frame = atlas_.rotatedSprite(sprites_.at(s), instance.size,
+                                                           instance.rotation);
+                if (!frame.isNull() && stretch_frames)
+                {
+                    painter.setTransform(device);
+                    QSizeF target_size(frame.width()*frame_scale_x, frame.height()*frame_scale_y);
+                    QRectF target(center - QPointF(target_size.width()/2.0, target_size.height()/2.0),
+                                  target_size);
+                    painter.drawImage(target, frame);
+                    continue;
+                }
+                if (!frame.isNull())
+                {
+                    painter.setTransform(device);
+                    QPointF top_left = center - QPointF(frame.width()/2.0, frame.height()/2.0);
+                    painter.drawImage(QPointF(std::floor(top_left.x() + 0.5),
+                                              std::floor(top_left.y() + 0.5)), frame);
+                    continue;
+                }
+                // Out of budget, rotate in scene coordinates, then scale
+                QTransform transform = scene;
+                transform.translate(instance.center.x(), instance.center.y());
+                transform.rotate(instance.rotation);
+                painter.setTransform(transform);
+                painter.drawImage(QRectF(-instance.size.width()/2.0, -instance.size.height()/2.0,
+                                         instance.size.width(), instance.size.height()), *image);
+            }
+        }
+        begin = end;
+    }
+
+    painter.restore();
+}
@@ -1,38 +1,20 @@
 #include "subscriber.h"
-#include "dev_msgs.pb.h"
+#include "ingestor.h"
 
-using namespace nzmqt;
+#include <algorithm>
+#include <cmath>
 
 Subscriber::Subscriber(const QList<QString>& addresses,
                      const QList<QString>& topics,
                      QObject *parent)
     : QObject(parent),
-      msg_top(CasuMsg(600,200)),
-      msg_bottom(CasuMsg(600,800)),
-      msg_cats(CatsMsg(950,500)),
-      addresses_(addresses),
-      topics_(topics),
-      socket_(NULL)
+      fish_density(QRectF(1040,50,480,900), 10.0),
+      msg_top(CasuMsg(&animator,600,200)),
+      msg_bottom(CasuMsg(&animator,600,800)),
+      msg_cats(CatsMsg(&animator,950,500)),
+      ingestor_(NULL),
+      drain_limit_(Ingestor::max_batch_records)
 {
-    context_ = createDefaultContext(this);
-    context_->start();
-
-    socket_ = context_->createSocket(ZMQSocket::TYP_SUB, this);
-    socket_->setObjectName("Subscriber.Socket.socket(SUB)");
-    connect(socket_, &ZMQSocket::messageReceived, this, &Subscriber::messageReceived);
-
-    for (int i = 0; i < topics_.length(); i++)
-    {
-        socket_->subscribeTo(topics_.at(i));
-        qDebug() << "Subscribed to " << topics_.at(i);
-    }
-
-    for (int i = 0; i < addresses_.length(); i++)
-    {
-        socket_->connectTo(addresses_.at(i));
-        qDebug() << "Connected socket to address " << addresses_.at(i);
-    }
-
     casu_data["casu-001"] = CasuData();
     // Set thresholds
     casu_data["casu-001"].ir_thresholds[0] = 11300;
@@ -51,135 +33,207 @@ Subscriber::Subscriber(const QList<QString>& addresses,
     casu_data["casu-002"].ir_thresholds[4] = 14500;
     casu_data["casu-002"].ir_thresholds[5] = 12500;
 
-    fish_data["fish-000"] = FishData();
-    fish_data["fish-001"] = FishData();
-    fish_data["fish-002"] = FishData();
-    fish_data["fish-003"] = FishData();
-    fish_data["fish-004"] = FishData();
-    //fish_data["fish-005"] = FishData();
-
-    ribot_data["ribot-000"] = FishData();
-    //ribot_data["ribot-001"] = FishData();
-    //ibot_data["ribot-002"] = FishData();
-    //ribot_data["ribot-003"] = FishData();
-}
+    // Agents appear as the tracker reports them. Tracker coordinates are
+    // in [0,500], mapped onto the fish tank
+    fish.setTransform(440.0/500.0, 900.0/500.0, 1055, 50);
+    fish.setDensityMap(&fish_density);
+    ribots.setTransform(440.0/500.0, 900.0/500.0, 1055, 50);
 
-void Subscriber::messageReceived(const QList<QByteArray>& message)
-{
-    std::string name(message.at(0).constData(), message.at(0).length());
-    if (casu_data.find(name) != casu_data.end())
+    // Receive and parse in the ingestion thread, deltas refer
+    // to CASUs by their index in casu_names
+    QList<QString> casu_names;
+    for (CasuMap::iterator it = casu_data.begin(); it != casu_data.end(); it++)
     {
-        // Received message is from one of the CASUs
-        std::string device(message.at(1).constData(), message.at(1).length());
-        std::string data(message.at(3).constData(), message.at(3).length());
-        if (device == "Temp")
+        casu_names.append(QString::fromStdString(it->first));
+        casus_.push_back(&it->second);
+        CasuMsg* msg = NULL;
+        if (it->first == "casu-001")
         {
-            // CASU temperature measurements
-            AssisiMsg::TemperatureArray temps;
-            temps.ParseFromString(data);
-            casu_data[name].temp = temps.temp(7); // TEMP_WAX is #7
-            //qDebug() << "Temperature> " << casu_data[name].temp;
+            msg = &msg_top;
         }
-        else if (device == "Peltier")
+        else if (it->first == "casu-002")
         {
-            // CASU temperature setpoint
-            AssisiMsg::Temperature temp;
-            temp.ParseFromString(data);
-            casu_data[name].temp_ref = temp.temp();
-            //qDebug() << "Peltier> " << temp;
+            msg = &msg_bottom;
         }
-        else if (device == "IR")
+        casu_msgs_.push_back(msg);
+    }
+    ingestor_ = new Ingestor(addresses, topics, casu_names);
+    ingestor_->moveToThread(&ingest_thread_);
+    connect(&ingest_thread_, &QThread::started, ingestor_, &Ingestor::start);
+    connect(&ingest_thread_, &QThread::finished, ingestor_, &QObject::deleteLater);
+    connect(ingestor_, &Ingestor::deltasAvailable, this, &Subscriber::dataChanged);
+    ingest_thread_.setObjectName("Subscriber.IngestThread");
+    ingest_thread_.start();
+}
+
+Subscriber::~Subscriber()
+{
+    ingest_thread_.quit();
+    ingest_thread_.wait();
+}
+
+bool Subscriber::drain()
+{
+    // Rearm first, deltas pushed while draining signal again
+    ingestor_->rearm();
+
+    bool changed = false;
+    StateDelta delta;
+    int deltas = 0;
+    while (deltas < drain_limit_ && ingestor_->queue().pop(delta))
+    {
+        changed = apply(delta) || changed;
+        deltas++;
+    }
+    qint64 time = animator.now();
+    fish.commit(time);
+    ribots.commit(time);
+
+    if (deltas == drain_limit_ && ingestor_->queue().size() > 0)
+    {
+        // A burst, keep the frame short and continue in the next one
+        emit dataChanged();
+    }
+    return changed;
+}
+
+void Subscriber::setDrainLimit(int deltas)
+{
+    drain_limit_ = std::max(1, deltas);
+}
+
+int Subscriber::drainLimit() const
+{
+    return drain_limit_;
+}
+
+void Subscriber::setPrediction(qint64 max_age)
+{
+    fish.setPrediction(max_age);
+    ribots.setPrediction(max_age);
+}
+
+void Subscriber::setSpinBudget(int usec)
+{
+    // The ingestor lives in the ingestion thread
+    QMetaObject::invokeMethod(ingestor_, "setSpinBudget", Qt::QueuedConnection, Q_ARG(int, usec));
+}
+
+quint64 Subscriber::receivedMessages() const
+{
+    return ingestor_->receivedMessages();
+}
+
+quint64 Subscriber::coalescedMessages() const
+{
+    return ingestor_->coalescedMessages();
+}
+
+quint64 Subscriber::malformedMessages() const
+{
+    return ingestor_->malformedMessages();
+}
+
+quint64 Subscriber::droppedDeltas() const
+{
+    return ingestor_->droppedDeltas();
+}
+
+quint64 Subscriber::lostBatches() const
+{
+    return ingestor_->lostBatches();
+}
+
+int Subscriber::fishDirection() const
+{
+    int direction = fish.groupDirection();
+    return direction != 0 ? direction : msg_cats.fish_direction;
+}
+
+int Subscriber::ribotDirection() const
+{
+    int direction = ribots.groupDirection();
+    return direction != 0 ? direction : msg_cats.ribot_direction;
+}
+
+bool Subscriber::apply(const StateDelta& delta)
+{
+    switch (delta.type)
+    {
+    case StateDelta::CasuTemp:
+    {
+        CasuData& casu = *casus_.at(delta.id);
+        if (casu.temp != delta.value[0])
         {
-            // CASU IR readings
-            AssisiMsg::RangeArray ranges;
-            ranges.ParseFromString(data);
-            for (int i = 0; i < ranges.raw_value_size(); i++)
-            {
-                if (static_cast<unsigned>(i) >= casu_data[name].ir_ranges.size()) break;
-                double raw = ranges.raw_value(i);
-                if (raw > casu_data[name].ir_thresholds[i])
-                {
-                    casu_data[name].ir_ranges[i] = 2.0;
-                }
-                else
-                {
-                    casu_data[name].ir_ranges[i] = 0.0;
-                }
-            }
+            casu.temp = delta.value[0];
+            casu.dirty = true;
         }
-        else if (device == "CommEth")
+        return casu.dirty;
+    }
+    case StateDelta::CasuSetpoint:
+    {
+        CasuData& casu = *casus_.at(delta.id);
+        if (casu.temp_ref != delta.value[0])
         {
-            QString msg_str = QString::fromUtf8(message.at(3).constData(), message.at(3).length());
-            QStringList parts(msg_str.split(','));
-            QStringList fish_dir(parts.at(0).split(':').at(1));//CW/CCW
-            QStringList ribot_dir(parts.at(1).split(':').at(1));
-            if (fish_dir.length() > 0 && ribot_dir.length() > 0)
-            {
-                msg_cats.incoming(fish_dir.at(0), ribot_dir.at(0));
-            }
+            casu.temp_ref = delta.value[0];
+            casu.dirty = true;
         }
-        emit pingReceived(message);
+        return casu.dirty;
     }
-    else if (name == "cats")
+    case StateDelta::CasuIr:
     {
-        QString sender(message.at(2));
-        bool ok = false;
-        if (sender == "casu-001")
+        CasuData& casu = *casus_.at(delta.id);
+        for (int i = 0; i < delta.count; i++)
         {
-            double val = message.at(3).toDouble(&ok)*6;
-            if (ok)
+            if (static_cast<unsigned>(i) >= casu.ir_ranges.size()) break;
+            double range = 0.0;
+            if (delta.value[i] > casu.ir_thresholds[i])
             {
-                msg_top.incoming(val);
+                range = 2.0;
             }
-        }
-        else if (sender == "casu-002")
-        {
-            double val = message.at(3).toDouble(&ok)*6;
-            if (ok)
+            if (casu.ir_ranges[i] != range)
             {
-                msg_bottom.incoming(val);
+                casu.ir_ranges[i] = range;
+                casu.dirty = true;
             }
         }
+        return casu.dirty;
     }
-    else if (name == "FishPosition")
+    case StateDelta::CatsMessage:
+        msg_cats.incoming(static_cast<int>(delta.value[0]), static_cast<int>(delta.value[1]));
+        return true;
+    case StateDelta::CasuMessage:
     {
-        QString id("fish-00");
-        id.append(message.at(1));
-        bool ok_x = false;
-        bool ok_y = false;
-        if (fish_data.find(id) != fish_data.end())
+        CasuMsg* msg = casu_msgs_.at(delta.id);
+        if (msg)
         {
-            double x = message.at(2).toDouble(&ok_x);
-            double y = message.at(3).toDouble(&ok_y);
-            if (ok_x && ok_y)
-            {
-                fish_data[id].appendPos(x,y);
-            }
+            msg->incoming(delta.count);
+            return true;
         }
+        return false;
     }
-    else if (name == "CASUPosition")
+    case StateDelta::FishPosition:
+    case StateDelta::RibotPosition:
     {
-        QString id("ribot-00");
-        id.append(message.at(1));
-        bool ok_x = false;
-        bool ok_y = false;
-        if (ribot_data.find(id) != ribot_data.end())
+        if (delta.id < 0)
         {
-            double x = message.at(2).toDouble(&ok_x);
-            double y = message.at(3).toDouble(&ok_y);
-            if (ok_x && ok_y)
-            {
-                ribot_data[id].appendPos(x,y,100,30);
-            }
+            return false;
         }
+        // Moved together by drain()
+        EntityStore& store = (delta.type == StateDelta::FishPosition ? fish : ribots);
+        store.stage(store.slot(delta.id), delta.value[0], delta.value[1], delta.value[2], delta.value[3]);
+        return true;
+    }
     }
+    return false;
 }
 
 Subscriber::CasuData::CasuData(void)
     : temp(27),
       temp_ref(27),
       ir_ranges(6),
-      ir_thresholds(6)
+      ir_thresholds(6),
+      dirty(true)
 {
     for (unsigned i = 0; i < ir_ranges.size(); i++)
     {
@@ -187,43 +241,17 @@ Subscriber::CasuData::CasuData(void)
     }
 }
 
-Subscriber::FishData::FishData(void)
-    : direction(1),
-      buff_max(10),
-      tank_scale_x(440.0/500.0),
-      tank_scale_y(900.0/500.0),
-      tank_offset_x(1055),
-      tank_offset_y(50)
-{
-    appendPos(100.0,100.0);
-    appendPos(100.0,100.0);
-}
-
-void Subscriber::FishData::appendPos(double xk, double yk, double w, double h)
-{
-    x.push_front(xk*tank_scale_x+tank_offset_x);
-    y.push_front(yk*tank_scale_y+tank_offset_y);
-
-    if (x.size() > buff_max)
-    {
-        x.pop_back();
-        y.pop_back();
-    }
-
-    // Create ractangle for rendering the fish
-    pose.setRect(x.at(0)-w/2.0, y.at(0)-h/2.0, w, h);
-    // TODO: compute swimming direction
-}
-
-Subscriber::CasuMsg::CasuMsg(int kx0, int ky, int kw, int kh)
-    : count(0),
+Subscriber::CasuMsg::CasuMsg(Animator* kanimator, int kx0, int ky, int kw, int kh)
+    : animator(kanimator),
+      count(0),
       x0(kx0),
       x(kx0),
       y(ky),
       w(kw),
       h(kh),
-      dx(4),
+      speed(120), // 4 px per frame at 30 fps
       x_max(1000),
+      tween(-1),
       active(false)
 {
 
@@ -235,27 +263,37 @@ void Subscriber::CasuMsg::incoming(int m)
     {
         count = m;
         active = true;
+        tween = animator->start(Keyframe(QPointF(x0,y)), Keyframe(QPointF(x_max,y)),
+                                (x_max - x0)/speed);
     }
     // Do not accept new messages while we are active
 }
 
-void Subscriber::CasuMsg::update(void)
+void Subscriber::CasuMsg::update(qint64 time)
 {
-    if (active)
+    if (!active)
     {
-        x += dx;
+        // Nothing on screen, nothing moves
+        return;
     }
 
-    if (x >= x_max)
+    damage |= pose;
+    x = animator->sample(tween, time).pos.x();
+
+    if (animator->finished(tween, time))
     {
+        animator->release(tween);
+        tween = -1;
         x = x0;
         active = false;
     }
     pose.setRect(x-w/2.0,y-h/2.0,w,h);
+    damage |= pose;
 }
 
-Subscriber::CatsMsg::CatsMsg(int kx0, int ky0, int kw, int kh)
-    : fish_direction(1),
+Subscriber::CatsMsg::CatsMsg(Animator* kanimator, int kx0, int ky0, int kw, int kh)
+    : animator(kanimator),
+      fish_direction(1),
       ribot_direction(1),
       x0(kx0),
       y0(ky0),
@@ -266,43 +304,73 @@ Subscriber::CatsMsg::CatsMsg(int kx0, int ky0, int kw, int kh)
       rot_ribot(0),
       w(kw),
       h(kh),
-      dx(-4),
-      dy(3),
-      drot(-12),
+      speed_x(120), // 4 px per frame at 30 fps
+      speed_y(90),
+      speed_rot(360),
       x_mid(800),
       x_min(600),
+      approach(-1),
+      split_top(-1),
+      split_bot(-1),
+      spin(-1),
       active(false)
 {
 
 }
 
-void Subscriber::CatsMsg::incoming(QString fish_dir, QString ribot_dir)
+void Subscriber::CatsMsg::incoming(int fish_dir, int ribot_dir)
 {
     if (!active)
     {
-        fish_direction = dir_to_int(fish_dir);
-        ribot_direction = dir_to_int(ribot_dir);
+        fish_direction = fish_dir;
+        ribot_direction = ribot_dir;
         active = true;
+
+        // Containers move left together, and move apart after x_mid
+        double t_mid = (x0 - x_mid)/speed_x;
+        double t_end = (x0 - x_min)/speed_x;
+        double spread = speed_y*(t_end - t_mid);
+        approach = animator->start(Keyframe(QPointF(x0,y0)), Keyframe(QPointF(x_mid,y0)), t_mid);
+        split_top = animator->start(Keyframe(QPointF(x_mid,y0)), Keyframe(QPointF(x_min,y0+spread)),
+                                    t_end - t_mid, t_mid);
+        split_bot = animator->start(Keyframe(QPointF(x_mid,y0)), Keyframe(QPointF(x_min,y0-spread)),
+                                    t_end - t_mid, t_mid);
+        // Icons turn by -speed_rot deg/s, the sign is flipped per direction
+        spin = animator->start(Keyframe(QPointF(), 0.0), Keyframe(QPointF(), -speed_rot*t_end), t_end);
     }
     // Do not accept new messages while we are active
 }
 
-void Subscriber::CatsMsg::update(void)
+void Subscriber::CatsMsg::update(qint64 time)
 {
-    if (active)
+    if (!active)
     {
-        x += dx;
-        if (x <= x_mid)
-        {
-            y_top += dy;
-            y_bot -= dy;
-        }
-        rot_fish += fish_direction * drot;
-        rot_ribot += ribot_direction * drot;
+        // Nothing on screen, nothing moves
+        return;
     }
 
-    if (x <= x_min)
+    // Direction icons spin and stick out of the containers
+    double r = std::sqrt(w*w/4.0 + h*h)/2.0;
+    damage |= pose_top.adjusted(-r, -r, r, r);
+    damage |= pose_bot.adjusted(-r, -r, r, r);
+
+    bool split = animator->finished(approach, time);
+    Keyframe top = animator->sample(split ? split_top : approach, time);
+    Keyframe bot = animator->sample(split ? split_bot : approach, time);
+    double rot = animator->sample(spin, time).rotation;
+    x = top.pos.x();
+    y_top = top.pos.y();
+    y_bot = bot.pos.y();
+    rot_fish = fish_direction*rot;
+    rot_ribot = ribot_direction*rot;
+
+    if (animator->finished(split_top, time))
     {
+        animator->release(approach);
+        animator->release(split_top);
+        animator->release(split_bot);
+        animator->release(spin);
+        approach = split_top = split_bot = spin = -1;
         active = false;
         x = x0;
         y_top = y0;
@@ -316,18 +384,6 @@ void Subscriber::CatsMsg::update(void)
     ribot_dir_bot.setRect(x-w/2.0,y_bot-h/2.0,w/2.0,h);
     fish_dir_top.setRect(x,y_top-h/2.0,w/2.0,h);
     fish_dir_bot.setRect(x,y_bot-h/2.0,w/2.0,h);
-}
-
-int Subscriber::CatsMsg::dir_to_int(QString dir)
-{
-    int result = 1;
-    if (dir == "CCW")
-    {
-        result = 1;
-    }
-    else if (dir == "CW")
-    {
-        result = -1;
-    }
-    return result;
+    damage |= pose_top.adjusted(-r, -r, r, r);
+    damage |= pose_bot.adjusted(-r, -r, r, r);
 }
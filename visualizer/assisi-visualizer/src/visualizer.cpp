@@ -1,20 +1,32 @@
 #include "visualizer.h"
 #include "ui_vassisi.h"
 #include "subscriber.h"
+#include "framerenderer.h"
+#include "framescheduler.h"
 
+#include <QDebug>
+#include <QMouseEvent>
 #include <QPainter>
-#include <QtSvg>
+#include <QPaintEvent>
+#include <QToolTip>
 
+#include <algorithm>
 #include <cmath>
-
-const double deg_to_rad = M_PI/180;
+#include <limits>
 
 Visualizer::Visualizer(const QString &config_path, QWidget *parent) :
     QWidget(parent),
     ui(new Ui::VAssisi),
-    default_scene_width_(1600),
-    default_scene_height_(1000),
-    td_(34) // 30 fps
+    renderer_(NULL),
+    frame_in_flight_(false),
+    scheduler_(NULL),
+    painted_fish_direction_(0),
+    painted_ribot_direction_(0),
+    stress_agents_(0),
+    stress_time_(0),
+    stats_frames_(0),
+    stats_render_time_(0),
+    stats_render_time_max_(0)
 
 {
     //TODO: Implement config file reading
@@ -34,297 +46,344 @@ Visualizer::Visualizer(const QString &config_path, QWidget *parent) :
     topics.append("cats");
 
     sub_ = new Subscriber(addresses,topics,this);
-    fish_tank_outer_.setRect(1040, 50, 480, 900);
-    fish_tank_inner_.setRect(1160, 170, 240, 660);
-
-    bee_arena_.setRect(80, 50, 480, 900);
-    casu_top_.setRect(260, 225, 100, 100);
-    casu_bottom_.setRect(260, 675, 100, 100);
-    heating_area_top_ = casu_top_.marginsAdded(QMargins(100,100,100,100));
-    heating_area_bottom_ = casu_bottom_.marginsAdded(QMargins(100,100,100,100));
-
-    double_arrow_.setRect(800-200, 500-200, 400, 400);
-    top_arrow_.setRect(800-200, 200-65, 400, 130);
-    bottom_arrow_.setRect(800-200, 800-65, 400, 130);
+    // Swimming directions are estimated around the tank centre
+    sub_->fish.setCenter(QRectF(layout_.fish_tank_inner).center());
+    sub_->ribots.setCenter(QRectF(layout_.fish_tank_inner).center());
 
     ui->setupUi(this);
 
-    svg_ = new QSvgRenderer(this);
-
-    QTimer* timer = new QTimer(this);
-    // Qt5 style connect does not work with overloaded functions
-    //connect(timer, &QTimer::timeout, this, &QWidget::update);
-    connect(timer, SIGNAL(timeout()), this, SLOT(update()));
-    timer->start(td_); // 30 FPS
+    // Frames are painted in the render thread, and only blitted here
+    qRegisterMetaType<SceneState>("SceneState");
+    renderer_ = new FrameRenderer(layout_);
+    renderer_->moveToThread(&render_thread_);
+    connect(&render_thread_, &QThread::finished, renderer_, &QObject::deleteLater);
+    connect(this, &Visualizer::renderRequested, renderer_, &FrameRenderer::render);
+    connect(renderer_, &FrameRenderer::frameReady, this, &Visualizer::frameReady);
+    render_thread_.setObjectName("Visualizer.RenderThread");
+    render_thread_.start();
+
+    // Frames are produced when data changes or animations run
+    scheduler_ = new FrameScheduler(this);
+    connect(scheduler_, &FrameScheduler::frame, this, &Visualizer::updateScene);
+    connect(scheduler_, &FrameScheduler::statistics, this, &Visualizer::showStatistics);
+    connect(sub_, &Subscriber::dataChanged, scheduler_, &FrameScheduler::requestFrame);
+    scheduler_->requestFrame();
 }
 
 Visualizer::~Visualizer()
 {
+    render_thread_.quit();
+    render_thread_.wait();
     delete sub_;
     delete ui;
 }
 
-void Visualizer::paintEvent(QPaintEvent *event)
+void Visualizer::startStressTest(int agents)
 {
-    QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing);
-    // Scale all items
-    double scaling_x = this->geometry().width()/default_scene_width_;
-    double scaling_y = this->geometry().height()/default_scene_height_;
-    painter.scale(scaling_x,
-                  scaling_y);
-
-    // Draw fish tank
-    svg_->load(QString("://artwork/fisharena2.svg"));
-    svg_->render(&painter, fish_tank_outer_);
-    painter.drawRect(fish_tank_outer_);
-    //painter.drawRect(fish_tank_inner_);
-
-    // Draw fish
-    if (sub_->msg_cats.fish_direction > 0)
+    qDebug() << "Stress test with" << agents << "agents";
+    stress_agents_ = agents;
+    sub_->fish.clear();
+    for (int i = 0; i < stress_agents_; i++)
     {
-        svg_->load(QString("://artwork/fish-ccw.svg"));
+        sub_->fish.slot(i);
     }
-    else
+    damage_ += rect();
+    scheduler_->requestFrame();
+}
+
+void Visualizer::setMaxFps(double fps)
+{
+    scheduler_->setMaxFps(fps);
+}
+
+void Visualizer::setPrediction(int msec)
+{
+    sub_->setPrediction(qint64(msec)*1000000);
+}
+
+void Visualizer::setReceiveSpin(int usec)
+{
+    sub_->setSpinBudget(usec);
+}
+
+void Visualizer::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    if (frame_.isNull())
     {
-        svg_->load(QString("://artwork/fish-cw.svg"));
+        // Nothing rendered yet
+        painter.fillRect(event->rect(), Qt::white);
+        return;
     }
-    for (Subscriber::FishMap::iterator it = sub_->fish_data.begin(); it != sub_->fish_data.end(); it++)
+
+    // The frame matches the widget, only blit the exposed part
+    qreal dpr = frame_.devicePixelRatio();
+    const QVector<QRect> rects = event->region().rects();
+    for (int i = 0; i < rects.size(); i++)
     {
-        svg_->render(&painter,it->second.pose);
+        const QRect& rect = rects.at(i);
+        painter.drawImage(rect, frame_, QRectF(rect.x()*dpr, rect.y()*dpr, rect.width()*dpr, rect.height()*dpr));
     }
+}
+
+void Visualizer::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    damage_ += rect();
+    scheduler_->requestFrame();
+}
+
+void Visualizer::mousePressEvent(QMouseEvent *event)
+{
+    // Widget to scene coordinates
+    QPointF pos(event->pos().x()*layout_.width/width(), event->pos().y()*layout_.height/height());
 
-    // Draw ribot
-    if (sub_->msg_cats.ribot_direction > 0)
+    // Ribots are drawn on top of the fish
+    EntityStore* stores[2] = {&sub_->ribots, &sub_->fish};
+    const char* kinds[2] = {"Ribot", "Fish"};
+    for (int s = 0; s < 2; s++)
     {
-        svg_->load(QString("://artwork/ribot-ccw.svg"));
+        // Within about half a sprite
+        int slot = stores[s]->pick(pos, 40.0);
+        if (slot < 0)
+        {
+            continue;
+        }
+        QPointF velocity = stores[s]->velocity(slot);
+        int direction = stores[s]->direction(slot);
+        QToolTip::showText(event->globalPos(),
+                           QString("%1 %2\n%3, %4 px/s")
+                           .arg(kinds[s]).arg(stores[s]->id(slot))
+                           .arg(direction > 0 ? "CCW" : (direction < 0 ? "CW" : "direction unknown"))
+                           .arg(std::sqrt(velocity.x()*velocity.x() + velocity.y()*velocity.y()), 0, 'f', 0),
+                           this);
+        return;
     }
-    else
+    QToolTip::hideText();
+    QWidget::mousePressEvent(event);
+}
+
+void Visualizer::updateScene(double dt)
+{
+    // Everything received since the last frame
+    sub_->drain();
+    qint64 time = sub_->animator.now();
+
+    if (stress_agents_ > 0)
     {
-        svg_->load(QString("://artwork/ribot-cw.svg"));
+        // Agents swim on circles around the tank center, in tracker coordinates
+        stress_time_ += dt;
+        for (int i = 0; i < sub_->fish.size(); i++)
+        {
+            double radius = 60.0 + std::fmod(i*37.0, 180.0);
+            double speed = (i % 2 ? 1.0 : -1.0)*(0.3 + std::fmod(i*0.618, 0.7));
+            double angle = i*2.399 + speed*stress_time_;
+            sub_->fish.stage(i, 250.0 + radius*std::cos(angle), 250.0 + radius*std::sin(angle),
+                             std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN());
+        }
+        sub_->fish.commit(time);
     }
-    for (Subscriber::FishMap::iterator it = sub_->ribot_data.begin(); it != sub_->ribot_data.end(); it++)
+
+    // Move the agents along their motion models, between tracker updates
+    bool predicting = sub_->fish.predict(time);
+    predicting = sub_->ribots.predict(time) || predicting;
+
+    // Sample message animations at frame time
+    sub_->msg_top.update(time);
+    sub_->msg_bottom.update(time);
+    sub_->msg_cats.update(time);
+
+    // Fade the fish occupancy
+    if (sub_->fish_density.update(time))
     {
-        svg_->render(&painter,it->second.pose);
+        addDamage(sub_->fish_density.area());
     }
 
-    // Draw bee arena
-    svg_->load(QString("://artwork/beearena.svg"));
-    svg_->render(&painter, bee_arena_);
-    //painter.drawRect(bee_arena_);
-
-    /* Draw CASU signals and bees */
-
-    // Draw top casu heating area
-    double r = heating_area_top_.height()/2.0;
-    QRadialGradient grad_top(heating_area_top_.center(),r);
-    QColor color = tempToColor(sub_->casu_data["casu-001"].temp);
-    grad_top.setColorAt(0.0,color);
-    grad_top.setColorAt(0.75,color);
-    grad_top.setColorAt(1,QColor(255,255,255,0));
-    painter.setBrush(grad_top);
-    painter.setPen(Qt::NoPen);
-    painter.drawEllipse(heating_area_top_);
-
-    // Draw bottom casu heating area
-    QRadialGradient grad_bottom(heating_area_bottom_.center(),r);
-    color = tempToColor(sub_->casu_data["casu-002"].temp);
-    grad_bottom.setColorAt(0.0,color);
-    grad_bottom.setColorAt(0.75,color);
-    grad_bottom.setColorAt(1,QColor(255,255,255,0));
-    painter.setBrush(grad_bottom);
-    painter.drawEllipse(heating_area_bottom_);
-
-    // Draw top casu proximity readings
-    // This is horrible, and probably works only for 0.0 and 2.0 readings :(
-    painter.setBrush(QColor(150,150,150,100));
-    unsigned num_readings = sub_->casu_data["casu-001"].ir_ranges.size();
-    double fov = 360.0 / num_readings - 2;
-    int h = heating_area_top_.height();
-    for (unsigned i = 0; i < num_readings; i++)
+    // Collect the areas that changed since the last frame
+    EntityStore* stores[2] = {&sub_->fish, &sub_->ribots};
+    for (int s = 0; s < 2; s++)
     {
-        QRect reading_area(heating_area_top_.topLeft(),heating_area_top_.bottomRight());
-        // ir_ranges[i] = 0 should show no reading (margin equal to area size)
-        // ir_ranges[i] = 2 is max reading (margin equal to 0.3 area size)
-        int margin = 0.5*h - 0.5*h*0.5*sub_->casu_data["casu-001"].ir_ranges[i]*0.7;
-        reading_area = reading_area.marginsRemoved(QMargins(margin, margin, margin, margin));
-        painter.drawPie(reading_area,(60*i-fov/2)*16, fov*16);
-        if (sub_->casu_data["casu-001"].ir_ranges[i] > 0.0)
+        const std::vector<int>& moved = stores[s]->dirtySlots();
+        for (size_t i = 0; i < moved.size(); i++)
         {
-            // A bee has been detected, render it
-            svg_->load(QString("://artwork/bee.svg"));
-            double dx = reading_area.width()/2*cos(60*i*deg_to_rad);
-            double dy = -reading_area.width()/2*sin(60*i*deg_to_rad);
-            svg_->render(&painter,QRectF(casu_top_.topLeft(),QSizeF(93.0,65.0)).adjusted(dx,dy,dx,dy));
+            addDamage(stores[s]->paintedPose(moved[i]));
+            addDamage(stores[s]->pose(moved[i]));
         }
+        stores[s]->clearDirty();
+    }
+    if (sub_->fishDirection() != painted_fish_direction_ ||
+        sub_->ribotDirection() != painted_ribot_direction_)
+    {
+        // Agent sprites change with the swimming direction
+        painted_fish_direction_ = sub_->fishDirection();
+        painted_ribot_direction_ = sub_->ribotDirection();
+        addDamage(layout_.fish_tank_outer);
     }
 
-    // Draw bottom casu proximity readings
-    // Again, this is absolutely horrible :(
-    num_readings = sub_->casu_data["casu-002"].ir_ranges.size();
-    fov = 360.0 / num_readings - 2;
-    h = heating_area_bottom_.height();
-    for (unsigned i = 0; i < num_readings; i++)
+    // Heat blobs, IR sectors, bees and setpoint knobs of each CASU
+    for (int c = 0; c < layout_.casus.size(); c++)
     {
-        QRect reading_area(heating_area_bottom_.topLeft(),heating_area_bottom_.bottomRight());
-        // ir_ranges[i] = 0 should show no reading (margin equal to area size)
-        // ir_ranges[i] = 2 is max reading (margin equal to 0.3 area size)
-        int margin = 0.5*h - 0.5*h*0.5*sub_->casu_data["casu-002"].ir_ranges[i]*0.7;
-        reading_area = reading_area.marginsRemoved(QMargins(margin, margin, margin, margin));
-        painter.drawPie(reading_area,(60*i-fov/2)*16, fov*16);
-        if (sub_->casu_data["casu-002"].ir_ranges[i] > 0.0)
+        Subscriber::CasuMap::iterator casu = sub_->casu_data.find(layout_.casus.at(c).name.toStdString());
+        if (casu != sub_->casu_data.end() && casu->second.dirty)
         {
-            // A bee has been detected, render it
-            svg_->load(QString("://artwork/bee.svg"));
-            double dx = reading_area.width()/2*cos(60*i*deg_to_rad);
-            double dy = -reading_area.width()/2*sin(60*i*deg_to_rad);
-            svg_->render(&painter,QRectF(casu_bottom_.topLeft(),QSizeF(93.0,65.0)).adjusted(dx,dy,dx,dy));
+            addDamage(layout_.casus.at(c).heating_area.marginsAdded(QMargins(20,20,20,20)));
+            casu->second.dirty = false;
         }
     }
 
-    // Draw temp scale
-    QConicalGradient grad_tref_top(casu_top_.center(),270);
-    QColor scale_color_min = tempToColor(24);
-    scale_color_min.setAlpha(255);
-    grad_tref_top.setColorAt(1,scale_color_min);
-    QColor scale_color_max = tempToColor(40);
-    scale_color_max.setAlpha(255);
-    grad_tref_top.setColorAt(0,scale_color_max);
-    painter.setBrush(grad_tref_top);
-    painter.drawPie(casu_top_,-45*16,270*16);
-    // Draw casu body
-    painter.setBrush(QBrush(QColor(255,255,255)));
-    painter.drawPie(casu_top_,225*16,90*16);
-    drawRotatedSvg(painter, casu_top_,
-                   tempToAngle(sub_->casu_data["casu-001"].temp_ref), QString("://artwork/button.svg"));
-    //svg_->render(&painter,casu_top_);
-    //painter.restore();
-
-    // Draw temp scale
-    QConicalGradient grad_tref_bottom(casu_bottom_.center(),270);
-    grad_tref_bottom.setColorAt(1,scale_color_min);
-    grad_tref_bottom.setColorAt(0,scale_color_max);
-    painter.setBrush(grad_tref_bottom);
-    painter.drawPie(casu_bottom_,-45*16,270*16);
-    // Draw casu body
-    painter.setBrush(QBrush(QColor(255,255,255)));
-    painter.drawPie(casu_bottom_,225*16,90*16);
-    drawRotatedSvg(painter, casu_bottom_,
-                   tempToAngle(sub_->casu_data["casu-002"].temp_ref), QString("://artwork/button.svg"));
-
-    // Draw comms
-    svg_->load(QString("://artwork/doublearrow.svg"));
-    svg_->render(&painter, double_arrow_);
-    svg_->load(QString("://artwork/arrow.svg"));
-    svg_->render(&painter, top_arrow_);
-    svg_->render(&painter, bottom_arrow_);
-
-    // Casu to cats
-    svg_->load(QString("://artwork/msgcontainer.svg"));
-    sub_->msg_top.update();
-    QFont font;
-    font.setPointSize(24);
-    painter.setFont(font);
-    if (sub_->msg_top.active)
+    addDamage(sub_->msg_top.damage);
+    sub_->msg_top.damage = QRectF();
+    addDamage(sub_->msg_bottom.damage);
+    sub_->msg_bottom.damage = QRectF();
+    addDamage(sub_->msg_cats.damage);
+    sub_->msg_cats.damage = QRectF();
+
+    scheduler_->setAnimating(stress_agents_ > 0 ||
+                             predicting ||
+                             sub_->msg_top.active ||
+                             sub_->msg_bottom.active ||
+                             sub_->msg_cats.active ||
+                             sub_->fish_density.active());
+    requestFrame();
+}
+
+void Visualizer::frameReady(const QImage& frame, const QRegion& damage, qint64 render_time)
+{
+    stats_frames_++;
+    stats_render_time_ += render_time;
+    stats_render_time_max_ = std::max(stats_render_time_max_, render_time);
+    if (stress_agents_ > 0 && stats_frames_ == 100)
     {
-        svg_->render(&painter, sub_->msg_top.pose);
-        painter.setPen(tempToColor(sub_->casu_data["casu-001"].temp));
-        painter.drawText(sub_->msg_top.pose,Qt::AlignCenter, QString::number(sub_->msg_top.count));
+        qDebug() << "Stress test:" << stress_agents_ << "agents, render time mean"
+                 << stats_render_time_/stats_frames_/1e6 << "ms, max"
+                 << stats_render_time_max_/1e6 << "ms";
     }
-    sub_->msg_bottom.update();
-    if (sub_->msg_bottom.active)
+    if (stats_frames_ == 100)
     {
-        svg_->render(&painter, sub_->msg_bottom.pose);
-        painter.setPen(tempToColor(sub_->casu_data["casu-002"].temp));
-        painter.drawText(sub_->msg_bottom.pose,Qt::AlignCenter, QString::number(sub_->msg_bottom.count));
+        stats_frames_ = 0;
+        stats_render_time_ = 0;
+        stats_render_time_max_ = 0;
     }
 
-    sub_->msg_cats.update();
-    //sub_->msg_cats.active = true;
-    if (sub_->msg_cats.active)
+    frame_in_flight_ = false;
+    scheduler_->frameFinished(render_time);
+    // Frames rendered for an outdated size are dropped,
+    // resizeEvent already asked for a new one
+    if (frame.size() == size()*devicePixelRatioF())
     {
-        // Render message containers
-        svg_->load(QString("://artwork/msgcontainer2.svg"));
-        painter.setPen(Qt::NoPen);
-        svg_->render(&painter, sub_->msg_cats.pose_top);
-        svg_->render(&painter, sub_->msg_cats.pose_bot);
-
-        // Render ribot swim directions twice
-        QString ribot_dir_svg("://artwork/msg-ribot-cw.svg");
-        if (sub_->msg_cats.ribot_direction > 0)
-        {
-            ribot_dir_svg = "://artwork/msg-ribot-ccw.svg";
-        }
-        drawRotatedSvg(painter, sub_->msg_cats.ribot_dir_top,
-                       sub_->msg_cats.rot_ribot, ribot_dir_svg);
-        drawRotatedSvg(painter, sub_->msg_cats.ribot_dir_bot,
-                       sub_->msg_cats.rot_ribot, ribot_dir_svg);
-
-        // Render fish swim directions twice
-        QString fish_dir_svg = "://artwork/msg-fish-cw.svg";
-        if (sub_->msg_cats.fish_direction > 0)
-        {
-            fish_dir_svg = "://artwork/msg-fish-ccw.svg";
-        }
-        drawRotatedSvg(painter, sub_->msg_cats.fish_dir_top,
-                       sub_->msg_cats.rot_fish, fish_dir_svg);
-        drawRotatedSvg(painter, sub_->msg_cats.fish_dir_bot,
-                       sub_->msg_cats.rot_fish, fish_dir_svg);
+        frame_ = frame;
+        update(damage);
+    }
+
+    // Catch up with damage collected while rendering
+    if (!damage_.isEmpty())
+    {
+        scheduler_->requestFrame();
     }
 }
 
-void Visualizer::drawRotatedSvg(QPainter& painter,
-                                QRectF area,
-                                double angle,
-                                const QString& resource_name)
+void Visualizer::showStatistics(double fps, qint64 dropped_frames)
 {
-    painter.save();
-
-    // TODO: should avoid recalculating the scaling factors
-    double scaling_x = this->geometry().width()/default_scene_width_;
-    double scaling_y = this->geometry().height()/default_scene_height_;
-
-    QTransform T;
-    T.scale(scaling_x,scaling_y);
-    T.translate(area.center().x(),
-                area.center().y());
-    painter.setWorldTransform(T);
-    painter.rotate(angle);
-    area.moveCenter(QPoint(0,0));
-    svg_->load(resource_name);
-    svg_->render(&painter, area);
-
-    painter.restore();
+    // Shoal metrics, from the spatial index of the fish
+    double distance = sub_->fish.meanNeighbourDistance();
+    // Receive counters, so lost data shows up next to the dropped frames
+    setWindowTitle(QString("VAssisi - %1 fps, %2 dropped frames - messages: %3 received, %4 coalesced, "
+                           "%5 malformed, %6 updates dropped, %7 batches lost - "
+                           "fish: %8 px to nearest, %9 aligned, %10 polarized")
+                   .arg(fps, 0, 'f', 1).arg(dropped_frames)
+                   .arg(sub_->receivedMessages()).arg(sub_->coalescedMessages())
+                   .arg(sub_->malformedMessages()).arg(sub_->droppedDeltas()).arg(sub_->lostBatches())
+                   .arg(std::isnan(distance) ? 0.0 : distance, 0, 'f', 0)
+                   .arg(sub_->fish.alignment(), 0, 'f', 2)
+                   .arg(sub_->fish.polarization(), 0, 'f', 2));
+}
+
+void Visualizer::addDamage(const QRectF& area)
+{
+    if (area.isNull())
+    {
+        return;
+    }
+
+    double scaling_x = this->geometry().width()/layout_.width;
+    double scaling_y = this->geometry().height()/layout_.height;
+    QRectF widget_area(area.x()*scaling_x, area.y()*scaling_y,
+                       area.width()*scaling_x, area.height()*scaling_y);
+    // Leave room for antialiased edges
+    damage_ += widget_area.toAlignedRect().adjusted(-2, -2, 2, 2);
+    // Many small rects cost more to clip than a few large ones
+    if (damage_.rectCount() > 64)
+    {
+        damage_ = damage_.boundingRect();
+    }
 }
 
-QColor Visualizer::tempToColor(double temp)
+SceneState Visualizer::snapshot() const
 {
-    double temp_min = 24.0;
-    double temp_max = 40.0;
-    temp = clip(temp, temp_min, temp_max);
+    SceneState state;
+
+    // Agents without a position yet have a null pose, and are not drawn
+    state.fish.resize(sub_->fish.size());
+    for (int i = 0; i < sub_->fish.size(); i++)
+    {
+        state.fish[i] = sub_->fish.pose(i);
+    }
+    state.ribots.resize(sub_->ribots.size());
+    for (int i = 0; i < sub_->ribots.size(); i++)
+    {
+        state.ribots[i] = sub_->ribots.pose(i);
+    }
+    state.fish_direction = sub_->fishDirection();
+    state.ribot_direction = sub_->ribotDirection();
+    state.fish_density = sub_->fish_density.image();
+    state.fish_density_area = sub_->fish_density.area();
 
-    double hue_min = 240;
-    double hue_max = 380;
-    double k = (hue_max - hue_min) / (temp_max - temp_min);
-    int hue = k*(temp-temp_min) + hue_min;
+    state.casus.resize(layout_.casus.size());
+    for (int c = 0; c < layout_.casus.size(); c++)
+    {
+        Subscriber::CasuMap::const_iterator casu = sub_->casu_data.find(layout_.casus.at(c).name.toStdString());
+        if (casu != sub_->casu_data.end())
+        {
+            state.casus[c].temp = casu->second.temp;
+            state.casus[c].temp_ref = casu->second.temp_ref;
+            state.casus[c].ir_ranges = casu->second.ir_ranges;
+        }
+    }
 
-    QColor color;
-    color.setHsv(hue, 255, 255, 100);
+    // Messages to CATS, top and bottom casu
+    const Subscriber::CasuMsg* casu_msgs[2] = {&sub_->msg_top, &sub_->msg_bottom};
+    for (int c = 0; c < 2 && c < state.casus.size(); c++)
+    {
+        state.casus[c].msg.active = casu_msgs[c]->active;
+        state.casus[c].msg.count = casu_msgs[c]->count;
+        state.casus[c].msg.pose = casu_msgs[c]->pose;
+    }
 
-    return color;
+    const Subscriber::CatsMsg& msg_cats = sub_->msg_cats;
+    state.cats_msg.active = msg_cats.active;
+    state.cats_msg.fish_direction = msg_cats.fish_direction;
+    state.cats_msg.ribot_direction = msg_cats.ribot_direction;
+    state.cats_msg.rot_fish = msg_cats.rot_fish;
+    state.cats_msg.rot_ribot = msg_cats.rot_ribot;
+    state.cats_msg.pose_top = msg_cats.pose_top;
+    state.cats_msg.pose_bot = msg_cats.pose_bot;
+    state.cats_msg.ribot_dir_top = msg_cats.ribot_dir_top;
+    state.cats_msg.ribot_dir_bot = msg_cats.ribot_dir_bot;
+    state.cats_msg.fish_dir_top = msg_cats.fish_dir_top;
+    state.cats_msg.fish_dir_bot = msg_cats.fish_dir_bot;
+
+    return state;
 }
 
-double Visualizer::tempToAngle(double temp)
+void Visualizer::requestFrame()
 {
-    double angle = 0.0;
-    double temp_min = 24.0;
-    double temp_max = 40.0;
-    temp = clip(temp, temp_min, temp_max);
-
-    double ang_min = 0.0;
-    double ang_max = 270.0;
-    double k = (ang_max - ang_min) / (temp_max - temp_min);
-    angle = k*(temp-temp_min) + ang_min;
+    if (frame_in_flight_ || damage_.isEmpty())
+    {
+        return;
+    }
 
-    return angle;
+    frame_in_flight_ = true;
+    scheduler_->frameStarted();
+    emit renderRequested(snapshot(), damage_, size(), devicePixelRatioF());
+    damage_ = QRegion();
 }
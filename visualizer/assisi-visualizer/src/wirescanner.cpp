@@ -0,0 +1,202 @@
+#include "wirescanner.h"
+
+#include <google/protobuf/descriptor.h>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace
+{
+
+typedef const unsigned char* Pos;
+
+enum WireType
+{
+    Varint = 0,
+    Fixed64 = 1,
+    LengthDelimited = 2,
+    Fixed32 = 5
+};
+
+bool readVarint(Pos& pos, Pos end, quint64* value)
+{
+    quint64 result = 0;
+    for (int shift = 0; shift < 64 && pos < end; shift += 7)
+    {
+        unsigned char byte = *pos++;
+        result |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+double readValue(Pos pos, bool is_float)
+{
+    if (is_float)
+    {
+        quint32 bits = qFromLittleEndian<quint32>(pos);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    quint64 bits = qFromLittleEndian<quint64>(pos);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+//! Walk all fields, storing the values of field, see WireScanner::values()
+/*!
+ * If keep_last is set, every value is stored in values[0].
+ */
+int scan(Pos pos, Pos end, const WireScanner::Field& field, double* values, int max, bool keep_last)
+{
+    const int value_size = field.is_float ? 4 : 8;
+    const int value_type = field.is_float ? Fixed32 : Fixed64;
+    int count = 0;
+
+    while (pos < end)
+    {
+        quint64 tag;
+        if (!readVarint(pos, end, &tag))
+        {
+            return -1;
+        }
+        int number = static_cast<int>(tag >> 3);
+        int type = static_cast<int>(tag & 7);
+
+        if (number == field.number)
+        {
+            if (type == value_type)
+            {
+                if (end - pos < value_size)
+                {
+                    return -1;
+                }
+                int index = keep_last ? 0 : count;
+                if (index < max)
+                {
+                    values[index] = readValue(pos, field.is_float);
+                }
+                pos += value_size;
+                count++;
+                continue;
+            }
+            if (type == LengthDelimited)
+            {
+                // Packed: a length, then the values back to back
+                quint64 length;
+                if (!readVarint(pos, end, &length) || length > quint64(end - pos) || length % value_size)
+                {
+                    return -1;
+                }
+                for (Pos value = pos; value < pos + length; value += value_size)
+                {
+                    int index = keep_last ? 0 : count;
+                    if (index < max)
+                    {
+                        values[index] = readValue(value, field.is_float);
+                    }
+                    count++;
+                }
+                pos += length;
+                continue;
+            }
+            // Not the type of the schema
+            return -1;
+        }
+
+        // Skip other fields
+        switch (type)
+        {
+        case Varint:
+        {
+            quint64 ignored;
+            if (!readVarint(pos, end, &ignored))
+            {
+                return -1;
+            }
+            break;
+        }
+        case Fixed64:
+            if (end - pos < 8)
+            {
+                return -1;
+            }
+            pos += 8;
+            break;
+        case LengthDelimited:
+        {
+            quint64 length;
+            if (!readVarint(pos, end, &length) || length > quint64(end - pos))
+            {
+                return -1;
+            }
+            pos += length;
+            break;
+        }
+        case Fixed32:
+            if (end - pos < 4)
+            {
+                return -1;
+            }
+            pos += 4;
+            break;
+        default:
+            // Groups are not used by the AssisiMsg types
+            return -1;
+        }
+    }
+    return count;
+}
+
+}
+
+WireScanner::Field WireScanner::resolve(const google::protobuf::Descriptor* type, const char* name)
+{
+    using google::protobuf::FieldDescriptor;
+
+    Field field;
+    field.number = -1;
+    field.is_float = false;
+    field.is_repeated = false;
+
+    const FieldDescriptor* descriptor = type ? type->FindFieldByName(name) : NULL;
+    if (descriptor && (descriptor->type() == FieldDescriptor::TYPE_DOUBLE ||
+                       descriptor->type() == FieldDescriptor::TYPE_FLOAT))
+    {
+        field.number = descriptor->number();
+        field.is_float = (descriptor->type() == FieldDescriptor::TYPE_FLOAT);
+        field.is_repeated = descriptor->is_repeated();
+    }
+    return field;
+}
+
+WireScanner::WireScanner(const char* data, std::size_t size)
+    : begin_(reinterpret_cast<const unsigned char*>(data)),
+      end_(reinterpret_cast<const unsigned char*>(data) + size)
+{
+
+}
+
+int WireScanner::values(const Field& field, double* values, int max) const
+{
+    if (!field.isValid())
+    {
+        return -1;
+    }
+    return scan(begin_, end_, field, values, max, false);
+}
+
+bool WireScanner::value(const Field& field, double* value) const
+{
+    if (!field.isValid())
+    {
+        return false;
+    }
+    return scan(begin_, end_, field, value, 1, true) > 0;
+}